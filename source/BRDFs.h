@@ -63,6 +63,22 @@ namespace dae
 			return f;
 		}
 
+		//alpha squared of the GGX terms, only depends on the roughness so materials precompute it
+		static float GetAlphaSquared_GGX(float roughness)
+		{
+			const auto alpha{ roughness * roughness };
+			return alpha * alpha;
+		}
+
+		//NormalDistribution_GGX with alphaSquared from GetAlphaSquared_GGX
+		static float NormalDistribution_GGX_Precomputed(const Vector3& n, const Vector3& h, float alphaSquared)
+		{
+			//ALWAYS MAKE SURE THAT THE DOT PRODUCT IS LARGER THAN 0
+			const auto dot{ std::max(0.f, Vector3::Dot(n, h)) };
+			const auto d{ alphaSquared / (M_PI * Square((Square(dot) * (alphaSquared - 1) + 1))) };
+			return d;
+		}
+
 		/**
 		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness))
 		 * \param n Surface normal
@@ -73,14 +89,31 @@ namespace dae
 		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float roughness)
 		{
 			//todo: W3
+			return NormalDistribution_GGX_Precomputed(n, h, GetAlphaSquared_GGX(roughness));
+		}
+
+
+		//k of the SchlickGGX term for direct lighting, only depends on the roughness so materials precompute it
+		static float GetK_SchlickGGX(float roughness)
+		{
 			const auto alpha{ roughness * roughness };
-			const auto alphaSquared{ alpha * alpha };
+			return Square(alpha + 1) / 8;
+		}
+
+		//GeometryFunction_SchlickGGX with k from GetK_SchlickGGX
+		static float GeometryFunction_SchlickGGX_Precomputed(const Vector3& n, const Vector3& v, float k)
+		{
 			//ALWAYS MAKE SURE THAT THE DOT PRODUCT IS LARGER THAN 0
-			const auto dot{ std::max(0.f, Vector3::Dot(n, h)) };
-			const auto d{ alphaSquared / (M_PI * Square((Square(dot) * (alphaSquared - 1) + 1))) };
-			return d;
+			const auto dot{ std::max(0.f, Vector3::Dot(n, v)) };
+			const auto g{ dot / (dot * (1 - k) + k) };
+			return g;
 		}
 
+		//GeometryFunction_Smith with k from GetK_SchlickGGX
+		static float GeometryFunction_Smith_Precomputed(const Vector3& n, const Vector3& v, const Vector3& l, float k)
+		{
+			return GeometryFunction_SchlickGGX_Precomputed(n, v, k) * GeometryFunction_SchlickGGX_Precomputed(n, l, k);
+		}
 
 		/**
 		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
@@ -92,12 +125,7 @@ namespace dae
 		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float roughness)
 		{
 			//todo: W3
-			//ALWAYS MAKE SURE THAT THE DOT PRODUCT IS LARGER THAN 0
-			const auto dot{ std::max(0.f, Vector3::Dot(n, v)) };
-			const auto alpha{ roughness * roughness };	
-			const auto k{ Square(alpha + 1) / 8 };
-			const auto g{ dot / (dot * (1 - k) + k) };
-			return g;
+			return GeometryFunction_SchlickGGX_Precomputed(n, v, GetK_SchlickGGX(roughness));
 		}
 
 		/**
@@ -112,7 +140,7 @@ namespace dae
 		{
 			//todo: W3
 			//assert(false && "Not Implemented Yet");
-			return GeometryFunction_SchlickGGX(n, v, roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
+			return GeometryFunction_Smith_Precomputed(n, v, l, GetK_SchlickGGX(roughness));
 		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "BVH.h"
+
+#include <cfloat>
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		struct Bin
+		{
+			AABB bounds{};
+			uint32_t primitiveCount{};
+		};
+
+		float NodeArea(const BVHNode& node)
+		{
+			const Vector3 extent{ node.maxAABB - node.minAABB };
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+
+		void UpdateNodeBounds(BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& primitiveOrder)
+		{
+			AABB bounds{};
+			for (uint32_t i{}; i < node.primitiveCount; ++i)
+			{
+				bounds.Grow(primitiveBounds[primitiveOrder[node.leftFirst + i]]);
+			}
+
+			node.minAABB = bounds.min;
+			node.maxAABB = bounds.max;
+		}
+
+		//Number of intersection batches needed for a primitive count, a partially filled batch costs as much as a full one
+		uint32_t BatchCount(uint32_t primitiveCount, uint32_t leafSize)
+		{
+			return (primitiveCount + leafSize - 1) / leafSize;
+		}
+
+		//Returns the SAH cost of the best split, FLT_MAX when the primitives can't be split
+		float FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<Vector3>& centroids,
+			const std::vector<uint32_t>& primitiveOrder, uint32_t leafSize, int& bestAxis, uint32_t& bestBin, AABB& centroidBounds)
+		{
+			for (uint32_t i{}; i < node.primitiveCount; ++i)
+			{
+				centroidBounds.Grow(centroids[primitiveOrder[node.leftFirst + i]]);
+			}
+
+			float bestCost{ FLT_MAX };
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const float boundsMin{ centroidBounds.min[axis] };
+				const float boundsMax{ centroidBounds.max[axis] };
+				if (boundsMin == boundsMax)
+					continue;
+
+				Bin bins[BVH_BIN_COUNT]{};
+				const float scale{ BVH_BIN_COUNT / (boundsMax - boundsMin) };
+				for (uint32_t i{}; i < node.primitiveCount; ++i)
+				{
+					const uint32_t primitiveIndex{ primitiveOrder[node.leftFirst + i] };
+					const uint32_t binIndex{ std::min(BVH_BIN_COUNT - 1, static_cast<uint32_t>((centroids[primitiveIndex][axis] - boundsMin) * scale)) };
+					++bins[binIndex].primitiveCount;
+					bins[binIndex].bounds.Grow(primitiveBounds[primitiveIndex]);
+				}
+
+				//Sweep from both sides to get the area and count left/right of every bin boundary
+				float leftArea[BVH_BIN_COUNT - 1]{}, rightArea[BVH_BIN_COUNT - 1]{};
+				uint32_t leftCount[BVH_BIN_COUNT - 1]{}, rightCount[BVH_BIN_COUNT - 1]{};
+				AABB leftBox{}, rightBox{};
+				uint32_t leftSum{}, rightSum{};
+				for (uint32_t i{}; i < BVH_BIN_COUNT - 1; ++i)
+				{
+					leftSum += bins[i].primitiveCount;
+					leftCount[i] = leftSum;
+					leftBox.Grow(bins[i].bounds);
+					leftArea[i] = leftBox.Area();
+
+					rightSum += bins[BVH_BIN_COUNT - 1 - i].primitiveCount;
+					rightCount[BVH_BIN_COUNT - 2 - i] = rightSum;
+					rightBox.Grow(bins[BVH_BIN_COUNT - 1 - i].bounds);
+					rightArea[BVH_BIN_COUNT - 2 - i] = rightBox.Area();
+				}
+
+				for (uint32_t i{}; i < BVH_BIN_COUNT - 1; ++i)
+				{
+					if (leftCount[i] == 0 || rightCount[i] == 0)
+						continue;
+
+					const float cost{ BatchCount(leftCount[i], leafSize) * leftArea[i] + BatchCount(rightCount[i], leafSize) * rightArea[i] };
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = i + 1;
+					}
+				}
+			}
+
+			return bestCost;
+		}
+	}
+
+	void BVH::Build(const std::vector<AABB>& primitiveBounds, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primitiveOrder, uint32_t leafSize)
+	{
+		const uint32_t nrOfPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+
+		nodes.clear();
+		primitiveOrder.resize(nrOfPrimitives);
+		std::iota(primitiveOrder.begin(), primitiveOrder.end(), 0u);
+
+		if (nrOfPrimitives == 0)
+			return;
+
+		//Primitives are binned by the center of their bounds
+		std::vector<Vector3> centroids(nrOfPrimitives);
+		for (uint32_t i{}; i < nrOfPrimitives; ++i)
+		{
+			centroids[i] = primitiveBounds[i].Center();
+		}
+
+		nodes.reserve(nrOfPrimitives * 2 - 1);
+		nodes.emplace_back();
+		nodes[0].leftFirst = 0;
+		nodes[0].primitiveCount = nrOfPrimitives;
+		UpdateNodeBounds(nodes[0], primitiveBounds, primitiveOrder);
+
+		//Iterative subdivision, large meshes would overflow the call stack
+		struct BuildTask
+		{
+			uint32_t nodeIndex;
+			uint32_t depth;
+		};
+		std::vector<BuildTask> tasks{ { 0, 1 } };
+
+		while (!tasks.empty())
+		{
+			const BuildTask task{ tasks.back() };
+			tasks.pop_back();
+
+			BVHNode& node{ nodes[task.nodeIndex] };
+			//A node that fits in one batch is tested at once, splitting it can only add work
+			if (node.primitiveCount <= leafSize || task.depth >= BVH_MAX_DEPTH)
+				continue;
+
+			int axis{};
+			uint32_t splitBin{};
+			AABB centroidBounds{};
+			const float splitCost{ FindBestSplit(node, primitiveBounds, centroids, primitiveOrder, leafSize, axis, splitBin, centroidBounds) };
+
+			//Stop when intersecting all primitives is cheaper than the best split
+			if (splitCost >= BatchCount(node.primitiveCount, leafSize) * NodeArea(node))
+				continue;
+
+			const float boundsMin{ centroidBounds.min[axis] };
+			const float scale{ BVH_BIN_COUNT / (centroidBounds.max[axis] - boundsMin) };
+			const auto first{ primitiveOrder.begin() + node.leftFirst };
+			const auto middle{ std::partition(first, first + node.primitiveCount, [&](uint32_t primitiveIndex)
+				{
+					const uint32_t binIndex{ std::min(BVH_BIN_COUNT - 1, static_cast<uint32_t>((centroids[primitiveIndex][axis] - boundsMin) * scale)) };
+					return binIndex < splitBin;
+				}) };
+
+			const uint32_t leftCount{ static_cast<uint32_t>(middle - first) };
+			if (leftCount == 0 || leftCount == node.primitiveCount)
+				continue;
+
+			const uint32_t leftIndex{ static_cast<uint32_t>(nodes.size()) };
+
+			BVHNode leftChild{};
+			leftChild.leftFirst = node.leftFirst;
+			leftChild.primitiveCount = leftCount;
+			UpdateNodeBounds(leftChild, primitiveBounds, primitiveOrder);
+
+			BVHNode rightChild{};
+			rightChild.leftFirst = node.leftFirst + leftCount;
+			rightChild.primitiveCount = node.primitiveCount - leftCount;
+			UpdateNodeBounds(rightChild, primitiveBounds, primitiveOrder);
+
+			node.leftFirst = leftIndex;
+			node.primitiveCount = 0;
+			node.splitAxis = static_cast<uint32_t>(axis);
+
+			nodes.push_back(leftChild);
+			nodes.push_back(rightChild);
+
+			tasks.push_back({ leftIndex, task.depth + 1 });
+			tasks.push_back({ leftIndex + 1, task.depth + 1 });
+		}
+
+		nodes.shrink_to_fit();
+	}
+
+	void BVH::Build(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<BVHNode>& nodes, std::vector<uint32_t>& triangleOrder, uint32_t leafSize)
+	{
+		const size_t nrOfTriangles{ indices.size() / 3 };
+
+		std::vector<AABB> triangleBounds(nrOfTriangles);
+		for (size_t i{}; i < nrOfTriangles; ++i)
+		{
+			triangleBounds[i].Grow(positions[indices[i * 3]]);
+			triangleBounds[i].Grow(positions[indices[i * 3 + 1]]);
+			triangleBounds[i].Grow(positions[indices[i * 3 + 2]]);
+		}
+
+		Build(triangleBounds, nodes, triangleOrder, leafSize);
+	}
+
+	float BVH::Refit(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& primitiveOrder, std::vector<BVHNode>& nodes)
+	{
+		if (nodes.empty())
+			return 0.f;
+
+		//Children are always stored after their parent, so a reverse sweep visits them first
+		float totalArea{};
+		for (size_t nodeIndex{ nodes.size() }; nodeIndex-- > 0;)
+		{
+			BVHNode& node{ nodes[nodeIndex] };
+
+			if (node.IsLeaf())
+			{
+				UpdateNodeBounds(node, primitiveBounds, primitiveOrder);
+			}
+			else
+			{
+				const BVHNode& leftChild{ nodes[node.leftFirst] };
+				const BVHNode& rightChild{ nodes[node.leftFirst + 1] };
+				node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+				node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+			}
+
+			totalArea += NodeArea(node) * (node.IsLeaf() ? node.primitiveCount : 1);
+		}
+
+		const float rootArea{ NodeArea(nodes[0]) };
+		return rootArea > 0.f ? totalArea / rootArea : 0.f;
+	}
+
+	float BVH::Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<BVHNode>& nodes)
+	{
+		if (nodes.empty())
+			return 0.f;
+
+		//Children are always stored after their parent, so a reverse sweep visits them first
+		float totalArea{};
+		for (size_t nodeIndex{ nodes.size() }; nodeIndex-- > 0;)
+		{
+			BVHNode& node{ nodes[nodeIndex] };
+			AABB bounds{};
+
+			if (node.IsLeaf())
+			{
+				const uint32_t lastIndex{ (node.leftFirst + node.primitiveCount) * 3 };
+				for (uint32_t i{ node.leftFirst * 3 }; i < lastIndex; ++i)
+				{
+					bounds.Grow(positions[indices[i]]);
+				}
+			}
+			else
+			{
+				const BVHNode& leftChild{ nodes[node.leftFirst] };
+				const BVHNode& rightChild{ nodes[node.leftFirst + 1] };
+				bounds.min = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+				bounds.max = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+			}
+
+			node.minAABB = bounds.min;
+			node.maxAABB = bounds.max;
+
+			totalArea += NodeArea(node) * (node.IsLeaf() ? node.primitiveCount : 1);
+		}
+
+		const float rootArea{ NodeArea(nodes[0]) };
+		return rootArea > 0.f ? totalArea / rootArea : 0.f;
+	}
+
+	BVHStats BVH::CalculateStats(std::span<const BVHNode> nodes)
+	{
+		BVHStats stats{};
+		if (nodes.empty())
+			return stats;
+
+		const float rootArea{ NodeArea(nodes[0]) };
+		uint32_t totalLeafPrimitives{};
+
+		struct StatsTask
+		{
+			uint32_t nodeIndex;
+			uint32_t depth;
+		};
+		std::vector<StatsTask> tasks{ { 0, 1 } };
+
+		while (!tasks.empty())
+		{
+			const StatsTask task{ tasks.back() };
+			tasks.pop_back();
+
+			const BVHNode& node{ nodes[task.nodeIndex] };
+			const float relativeArea{ rootArea > 0.f ? NodeArea(node) / rootArea : 1.f };
+
+			++stats.nodeCount;
+			stats.maxDepth = std::max(stats.maxDepth, task.depth);
+
+			if (node.IsLeaf())
+			{
+				++stats.leafCount;
+				totalLeafPrimitives += node.primitiveCount;
+				stats.sahCost += relativeArea * node.primitiveCount;
+			}
+			else
+			{
+				stats.sahCost += relativeArea;
+				tasks.push_back({ node.leftFirst, task.depth + 1 });
+				tasks.push_back({ node.leftFirst + 1, task.depth + 1 });
+			}
+		}
+
+		stats.averageLeafSize = totalLeafPrimitives / static_cast<float>(stats.leafCount);
+		return stats;
+	}
+}
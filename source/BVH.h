@@ -0,0 +1,120 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Maximum depth of a BVH, traversal stacks are sized with this
+	constexpr uint32_t BVH_MAX_DEPTH{ 64 };
+	//Number of centroid bins evaluated per axis by the binned SAH builder
+	constexpr uint32_t BVH_BIN_COUNT{ 16 };
+	//A refitted BVH gets rebuilt once its SAH cost grows past this factor of the cost right after the build
+	constexpr float BVH_REFIT_REBUILD_THRESHOLD{ 1.5f };
+
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& p)
+		{
+			min = Vector3::Min(min, p);
+			max = Vector3::Max(max, p);
+		}
+
+		void Grow(const AABB& box)
+		{
+			min = Vector3::Min(min, box.min);
+			max = Vector3::Max(max, box.max);
+		}
+
+		Vector3 Center() const
+		{
+			return (min + max) * 0.5f;
+		}
+
+		float Area() const
+		{
+			const Vector3 extent{ max - min };
+			if (extent.x < 0.f)
+				return 0.f;
+
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		//Internal node: index of the left child, the right child is stored right after it
+		//Leaf node: index of the first primitive of the leaf
+		uint32_t leftFirst{};
+		uint32_t primitiveCount : 30 {};
+		//Internal node: axis the children were split on, the left child holds the lower centroids
+		uint32_t splitAxis : 2 {};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	struct BVHStats
+	{
+		uint32_t nodeCount{};
+		uint32_t leafCount{};
+		uint32_t maxDepth{};
+		float averageLeafSize{};
+		float sahCost{};
+	};
+
+	namespace BVH
+	{
+		/**
+		 * \brief Builds a BVH over arbitrary primitives using the binned surface area heuristic
+		 * \param primitiveBounds world bounds of every primitive
+		 * \param nodes output node array, node 0 is the root
+		 * \param primitiveOrder output permutation, leaves reference primitive primitiveOrder[leftFirst + i]
+		 * \param leafSize number of primitives tested at once, nodes this small always become leaves and the SAH counts whole batches
+		 */
+		void Build(const std::vector<AABB>& primitiveBounds, std::vector<BVHNode>& nodes, std::vector<uint32_t>& primitiveOrder, uint32_t leafSize = 1);
+
+		/**
+		 * \brief Builds a BVH over a triangle list using the binned surface area heuristic
+		 * \param positions vertex positions the triangles are built from
+		 * \param indices triangle list, 3 indices per triangle
+		 * \param nodes output node array, node 0 is the root
+		 * \param triangleOrder output permutation, leaves reference triangle triangleOrder[leftFirst + i]
+		 * \param leafSize number of triangles tested at once, see the overload above
+		 */
+		void Build(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<BVHNode>& nodes, std::vector<uint32_t>& triangleOrder, uint32_t leafSize = 1);
+
+		/**
+		 * \brief Recomputes all node bounds bottom-up for moved primitives, keeping the topology of the tree
+		 * \param primitiveBounds current bounds of every primitive
+		 * \param primitiveOrder permutation returned by Build
+		 * \param nodes node array created by Build
+		 * \return SAH cost of the refitted tree (relative to the root area)
+		 */
+		float Refit(const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& primitiveOrder, std::vector<BVHNode>& nodes);
+
+		/**
+		 * \brief Recomputes all node bounds bottom-up for moved vertices, keeping the topology of the tree
+		 * \param positions vertex positions the triangles are built from
+		 * \param indices triangle list in the order the BVH was built with
+		 * \param nodes node array created by Build
+		 * \return SAH cost of the refitted tree (relative to the root area)
+		 */
+		float Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<BVHNode>& nodes);
+
+		/**
+		 * \brief Walks the node array to report the quality of a BVH
+		 * \param nodes node array created by Build
+		 * \return node count, depth, average leaf size and SAH cost (relative to the root area)
+		 */
+		BVHStats CalculateStats(std::span<const BVHNode> nodes);
+	}
+}
@@ -0,0 +1,238 @@
+#include "Benchmark.h"
+
+//Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+//Project includes
+#include "FrameBuffer.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Nearest rank percentile of sorted values
+		double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+		{
+			const size_t rank{ static_cast<size_t>(std::ceil(percentile * sortedValues.size())) };
+			return sortedValues[std::clamp<size_t>(rank, 1, sortedValues.size()) - 1];
+		}
+
+		//Finds "key": value in the text of one JSON object, strings are returned without their quotes
+		bool FindValue(const std::string& objectText, const std::string& key, std::string& value)
+		{
+			const size_t keyPosition{ objectText.find("\"" + key + "\"") };
+			if (keyPosition == std::string::npos)
+				return false;
+
+			size_t valueStart{ objectText.find(':', keyPosition) };
+			if (valueStart == std::string::npos)
+				return false;
+			valueStart = objectText.find_first_not_of(" \t\r\n", valueStart + 1);
+			if (valueStart == std::string::npos)
+				return false;
+
+			if (objectText[valueStart] == '"')
+			{
+				const size_t valueEnd{ objectText.find('"', valueStart + 1) };
+				value = objectText.substr(valueStart + 1, valueEnd - valueStart - 1);
+			}
+			else
+			{
+				const size_t valueEnd{ objectText.find_first_of(",}\r\n", valueStart) };
+				value = objectText.substr(valueStart, valueEnd - valueStart);
+			}
+			return true;
+		}
+
+		template<typename T>
+		void ReadNumber(const std::string& objectText, const std::string& key, T& number)
+		{
+			std::string value{};
+			if (FindValue(objectText, key, value))
+				std::istringstream{ value } >> number;
+		}
+
+		const BenchmarkResult* FindResult(const std::vector<BenchmarkResult>& results, const std::string& sceneName)
+		{
+			const auto it{ std::find_if(results.begin(), results.end(), [&](const BenchmarkResult& result) { return result.sceneName == sceneName; }) };
+			return it != results.end() ? &*it : nullptr;
+		}
+	}
+
+	bool Benchmark::Run(const std::string& sceneName, const BenchmarkSettings& settings, BenchmarkResult& result)
+	{
+		Scene* pScene{ CreateScene(sceneName) };
+		if (!pScene)
+		{
+			std::cout << "Unknown scene " << sceneName << "\n";
+			return false;
+		}
+
+		FrameBuffer frameBuffer{ settings.width, settings.height };
+		if (!frameBuffer.GetPixels())
+		{
+			std::cout << "Could not allocate a " << settings.width << "x" << settings.height << " frame buffer\n";
+			delete pScene;
+			return false;
+		}
+
+		Renderer renderer{ &frameBuffer };
+		renderer.SetTileSize(settings.tileSize);
+		//The frozen scene never changes, every frame has to be traced to be measured
+		renderer.SetFrameReuse(false);
+		if (settings.threadCount > 0 || settings.pinThreads)
+			renderer.SetThreadCount(settings.threadCount, settings.pinThreads ? ThreadPinning::Compact : ThreadPinning::None);
+
+		//No elapsed time means the camera ignores input, animations only depend on the frozen total time
+		Timer timer{};
+		timer.Freeze(settings.sceneTime);
+
+		pScene->Initialize();
+
+		std::vector<double> frameTimes{};
+		frameTimes.reserve(settings.frameCount);
+		RenderStatistics statistics{};
+
+		for (uint32_t frame{}; frame < settings.warmupFrameCount + settings.frameCount; ++frame)
+		{
+			const auto frameStart{ std::chrono::steady_clock::now() };
+			pScene->Update(&timer);
+			renderer.Render(pScene);
+			const auto frameEnd{ std::chrono::steady_clock::now() };
+
+			if (frame < settings.warmupFrameCount)
+				continue;
+
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+			statistics += renderer.GetFrameStatistics();
+		}
+
+		delete pScene;
+
+		const double totalSeconds{ std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / 1000.0 };
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		result.sceneName = sceneName;
+		result.width = settings.width;
+		result.height = settings.height;
+		result.frameCount = settings.frameCount;
+		result.threadCount = renderer.GetThreadCount();
+		result.p50FrameTime = GetPercentile(frameTimes, 0.50);
+		result.p95FrameTime = GetPercentile(frameTimes, 0.95);
+		result.p99FrameTime = GetPercentile(frameTimes, 0.99);
+		result.averageFrameTime = totalSeconds * 1000.0 / settings.frameCount;
+		result.primaryRaysPerSecond = statistics.primaryRays / totalSeconds;
+		result.shadowRaysPerSecond = statistics.shadowRays / totalSeconds;
+		return true;
+	}
+
+	bool Benchmark::WriteJSON(const std::string& path, const std::vector<BenchmarkResult>& results)
+	{
+		std::ofstream fileStream{ path };
+		if (!fileStream)
+			return false;
+
+		fileStream << std::fixed << std::setprecision(4);
+		fileStream << "{\n\t\"scenes\": [\n";
+		for (size_t i{}; i < results.size(); ++i)
+		{
+			const BenchmarkResult& result{ results[i] };
+			fileStream << "\t\t{\n"
+				<< "\t\t\t\"scene\": \"" << result.sceneName << "\",\n"
+				<< "\t\t\t\"width\": " << result.width << ",\n"
+				<< "\t\t\t\"height\": " << result.height << ",\n"
+				<< "\t\t\t\"frames\": " << result.frameCount << ",\n"
+				<< "\t\t\t\"threads\": " << result.threadCount << ",\n"
+				<< "\t\t\t\"p50_ms\": " << result.p50FrameTime << ",\n"
+				<< "\t\t\t\"p95_ms\": " << result.p95FrameTime << ",\n"
+				<< "\t\t\t\"p99_ms\": " << result.p99FrameTime << ",\n"
+				<< "\t\t\t\"average_ms\": " << result.averageFrameTime << ",\n"
+				<< "\t\t\t\"primary_rays_per_second\": " << result.primaryRaysPerSecond << ",\n"
+				<< "\t\t\t\"shadow_rays_per_second\": " << result.shadowRaysPerSecond << "\n"
+				<< "\t\t}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		fileStream << "\t]\n}\n";
+
+		return fileStream.good();
+	}
+
+	bool Benchmark::ReadJSON(const std::string& path, std::vector<BenchmarkResult>& results)
+	{
+		std::ifstream fileStream{ path };
+		if (!fileStream)
+			return false;
+
+		const std::string text{ std::istreambuf_iterator<char>{ fileStream }, std::istreambuf_iterator<char>{} };
+
+		//Every result is a flat object starting with its scene name
+		results.clear();
+		size_t objectStart{ text.find("\"scene\"") };
+		while (objectStart != std::string::npos)
+		{
+			const size_t objectEnd{ text.find('}', objectStart) };
+			const std::string objectText{ text.substr(objectStart, objectEnd - objectStart) };
+
+			BenchmarkResult result{};
+			FindValue(objectText, "scene", result.sceneName);
+			ReadNumber(objectText, "width", result.width);
+			ReadNumber(objectText, "height", result.height);
+			ReadNumber(objectText, "frames", result.frameCount);
+			ReadNumber(objectText, "threads", result.threadCount);
+			ReadNumber(objectText, "p50_ms", result.p50FrameTime);
+			ReadNumber(objectText, "p95_ms", result.p95FrameTime);
+			ReadNumber(objectText, "p99_ms", result.p99FrameTime);
+			ReadNumber(objectText, "average_ms", result.averageFrameTime);
+			ReadNumber(objectText, "primary_rays_per_second", result.primaryRaysPerSecond);
+			ReadNumber(objectText, "shadow_rays_per_second", result.shadowRaysPerSecond);
+			results.push_back(result);
+
+			objectStart = text.find("\"scene\"", objectEnd);
+		}
+
+		return !results.empty();
+	}
+
+	uint32_t Benchmark::Compare(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& results, double tolerance)
+	{
+		uint32_t regressionCount{};
+
+		std::cout << std::fixed << std::setprecision(2);
+		for (const BenchmarkResult& result : results)
+		{
+			const BenchmarkResult* pBaselineResult{ FindResult(baseline, result.sceneName) };
+			if (!pBaselineResult)
+			{
+				std::cout << result.sceneName << ": not in the baseline\n";
+				continue;
+			}
+
+			if (pBaselineResult->width != result.width || pBaselineResult->height != result.height || pBaselineResult->threadCount != result.threadCount)
+				std::cout << result.sceneName << ": baseline was measured with a different resolution or thread count\n";
+
+			const bool isRegression{ result.p50FrameTime > pBaselineResult->p50FrameTime * (1.0 + tolerance)
+				|| result.p95FrameTime > pBaselineResult->p95FrameTime * (1.0 + tolerance) };
+			if (isRegression)
+				++regressionCount;
+
+			std::cout << result.sceneName
+				<< ": p50 " << pBaselineResult->p50FrameTime << " -> " << result.p50FrameTime << " ms"
+				<< ", p95 " << pBaselineResult->p95FrameTime << " -> " << result.p95FrameTime << " ms"
+				<< ", p99 " << pBaselineResult->p99FrameTime << " -> " << result.p99FrameTime << " ms"
+				<< (isRegression ? "  REGRESSION\n" : "\n");
+		}
+		std::cout << std::defaultfloat;
+
+		return regressionCount;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//How every scene of a benchmark run gets rendered
+	struct BenchmarkSettings
+	{
+		int width{ 640 };
+		int height{ 480 };
+		uint32_t frameCount{ 30 };
+		//Rendered before measuring, they fault in memory and wake up the workers
+		uint32_t warmupFrameCount{ 2 };
+		//Scene time every frame is rendered at, so animated meshes hold still
+		float sceneTime{ 0.f };
+
+		uint32_t threadCount{}; //0 uses every hardware thread
+		uint32_t tileSize{ 16 };
+		bool pinThreads{ false };
+	};
+
+	//Measurements of one scene, frame times are in milliseconds and include the scene update
+	struct BenchmarkResult
+	{
+		std::string sceneName{};
+		int width{};
+		int height{};
+		uint32_t frameCount{};
+		uint32_t threadCount{};
+
+		double p50FrameTime{};
+		double p95FrameTime{};
+		double p99FrameTime{};
+		double averageFrameTime{};
+
+		double primaryRaysPerSecond{};
+		double shadowRaysPerSecond{};
+	};
+
+	namespace Benchmark
+	{
+		/**
+		 * \brief Renders a built-in scene headless with a frozen camera and scene time
+		 * \param sceneName class name of the scene, see GetSceneNames
+		 * \param result filled in when the scene exists
+		 * \return false when there is no scene with that name or the frame buffer couldn't be allocated, the reason is printed
+		 */
+		bool Run(const std::string& sceneName, const BenchmarkSettings& settings, BenchmarkResult& result);
+
+		//Returns false when the file couldn't be written
+		bool WriteJSON(const std::string& path, const std::vector<BenchmarkResult>& results);
+		//Only reads the files written by WriteJSON, returns false when the file couldn't be opened or holds no results
+		bool ReadJSON(const std::string& path, std::vector<BenchmarkResult>& results);
+
+		/**
+		 * \brief Prints every scene next to its baseline and flags the ones that got slower
+		 * \param tolerance allowed relative slowdown of the p50 and p95 frame times, e.g. 0.05 for 5%
+		 * \return number of regressed scenes, scenes missing from the baseline are reported but don't count
+		 */
+		uint32_t Compare(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& results, double tolerance);
+	}
+}
@@ -33,6 +33,9 @@ namespace dae
 
 		float movementSpeed{ 5.f };
 
+		//Set whenever the view changed, the renderer clears it once it rendered that view
+		bool isDirty{ true };
+
 		Matrix CalculateCameraToWorld()
 		{
 			//todo: W2
@@ -46,6 +49,7 @@ namespace dae
 			up = rotation.GetAxisY();
 
 			cameraToWorld = { right, up, forward, origin };
+			isDirty = true;
 			return cameraToWorld;
 		}
 
@@ -70,9 +74,18 @@ namespace dae
 			if (pKeyboardState[SDL_SCANCODE_LEFT])
 				fovAngle += 5.f;
 
+			//A held movement key only moves the camera when time passed, e.g. not while the timer is frozen
+			const bool isMoving{ pKeyboardState[SDL_SCANCODE_W] || pKeyboardState[SDL_SCANCODE_A] || pKeyboardState[SDL_SCANCODE_S] || pKeyboardState[SDL_SCANCODE_D] };
+			if ((isMoving && deltaTime != 0.f) || pKeyboardState[SDL_SCANCODE_LEFT])
+				isDirty = true;
+
 			//Mouse Input
 			int mouseX{}, mouseY{};
 			const uint32_t mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
+			//Holding a button without moving the mouse leaves the view as it is
+			if (mouseX == 0 && mouseY == 0)
+				return;
+
 			if (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT) && mouseState & SDL_BUTTON(SDL_BUTTON_RIGHT))
 			{
 				origin += up * (float)-mouseY * deltaTime;
@@ -1,6 +1,12 @@
 #pragma once
+#include <bit>
 #include <cassert>
+#include <memory>
+#include <span>
 #include "Math.h"
+#include "BVH.h"
+#include "MappedFile.h"
+#include "Trace.h"
 #include "vector"
 #include <iostream>
 
@@ -23,6 +29,12 @@ namespace dae
 		unsigned char materialIndex{ 0 };
 	};
 
+	enum class BVHUpdateMode
+	{
+		Rebuild, //Build a new BVH on every update
+		Refit //Keep the topology and only update the bounds, rebuild when the quality degrades too much
+	};
+
 	enum class TriangleCullMode
 	{
 		FrontFaceCulling,
@@ -54,62 +66,135 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
+	//Triangle in the layout the scalar intersection tests read: no index lookups and the Moller-Trumbore edges are precomputed
+	struct alignas(16) PrecomputedTriangle
+	{
+		Vector3 v0{};
+		Vector3 edge1{}; //v1 - v0
+		Vector3 edge2{}; //v2 - v0
+		Vector3 normal{};
+	};
+
+	//Triangles per TriangleBlock, one AVX2 register or two SSE registers per component
+	constexpr uint32_t TRIANGLE_BLOCK_WIDTH{ 8 };
+
+	//Structure of arrays version of PrecomputedTriangle, lets one ray be tested against a whole block at once
+	//Unused lanes are zeroed, a degenerate triangle can never be hit
+	struct alignas(32) TriangleBlock
+	{
+		float v0X[TRIANGLE_BLOCK_WIDTH]{};
+		float v0Y[TRIANGLE_BLOCK_WIDTH]{};
+		float v0Z[TRIANGLE_BLOCK_WIDTH]{};
+		float edge1X[TRIANGLE_BLOCK_WIDTH]{};
+		float edge1Y[TRIANGLE_BLOCK_WIDTH]{};
+		float edge1Z[TRIANGLE_BLOCK_WIDTH]{};
+		float edge2X[TRIANGLE_BLOCK_WIDTH]{};
+		float edge2Y[TRIANGLE_BLOCK_WIDTH]{};
+		float edge2Z[TRIANGLE_BLOCK_WIDTH]{};
+		float normalX[TRIANGLE_BLOCK_WIDTH]{};
+		float normalY[TRIANGLE_BLOCK_WIDTH]{};
+		float normalZ[TRIANGLE_BLOCK_WIDTH]{};
+
+		void SetTriangle(uint32_t lane, const PrecomputedTriangle& triangle)
+		{
+			v0X[lane] = triangle.v0.x; v0Y[lane] = triangle.v0.y; v0Z[lane] = triangle.v0.z;
+			edge1X[lane] = triangle.edge1.x; edge1Y[lane] = triangle.edge1.y; edge1Z[lane] = triangle.edge1.z;
+			edge2X[lane] = triangle.edge2.x; edge2Y[lane] = triangle.edge2.y; edge2Z[lane] = triangle.edge2.z;
+			normalX[lane] = triangle.normal.x; normalY[lane] = triangle.normal.y; normalZ[lane] = triangle.normal.z;
+		}
+
+		PrecomputedTriangle GetTriangle(uint32_t lane) const
+		{
+			return PrecomputedTriangle{
+				{ v0X[lane], v0Y[lane], v0Z[lane] },
+				{ edge1X[lane], edge1Y[lane], edge1Z[lane] },
+				{ edge2X[lane], edge2Y[lane], edge2Z[lane] },
+				{ normalX[lane], normalY[lane], normalZ[lane] } };
+		}
+	};
+
+	//Read-only arrays of a mesh loaded from a mesh cache, they point straight into the mapped file
+	struct MappedMeshData
+	{
+		std::shared_ptr<const MappedFile> pFile{};
+
+		std::span<const Vector3> positions{};
+		std::span<const Vector3> normals{};
+		std::span<const int> indices{};
+		std::span<const BVHNode> bvhNodes{};
+		std::span<const TriangleBlock> triangleBlocks{};
+		std::span<const uint32_t> bvhLeafFirstBlock{};
+	};
+
+	//Geometry shared by every instance of a mesh, everything is stored in object space
 	struct TriangleMesh
 	{
 		TriangleMesh() = default;
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), cullMode(_cullMode)
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices) :
+			positions(_positions), indices(_indices)
 		{
 			//Calculate Normals
 			CalculateNormals();
 
-			//Update Transforms
-			UpdateTransforms();
+			//Build the acceleration structure
+			UpdateBVH();
 		}
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals) :
+			positions(_positions), normals(_normals), indices(_indices)
 		{
-			UpdateTransforms();
+			UpdateBVH();
 		}
 
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
-
-		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
-
-		Matrix rotationTransform{};
-		Matrix translationTransform{};
-		Matrix scaleTransform{};
 
 		Vector3 minAABB;
 		Vector3 maxAABB;
 
-		Vector3 transformedMinAABB;
-		Vector3 transformedMaxAABB;
+		//Flat BVH over the object space triangles, leaves index straight into indices/normals
+		std::vector<BVHNode> bvhNodes{};
+		BVHUpdateMode bvhUpdateMode{ BVHUpdateMode::Refit };
+		float bvhBuildSAHCost{};
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		//Baked copy of the triangles, every leaf owns ceil(primitiveCount / TRIANGLE_BLOCK_WIDTH) consecutive blocks
+		//starting at bvhLeafFirstBlock[leaf node index], rebuilt by UpdateBVH
+		std::vector<TriangleBlock> triangleBlocks{};
+		std::vector<uint32_t> bvhLeafFirstBlock{};
 
-		void Translate(const Vector3& translation)
-		{
-			translationTransform = Matrix::CreateTranslation(translation);
-		}
+		//Set by MeshCache::LoadOBJ, the vectors above stay empty while the mesh reads from the mapped file
+		MappedMeshData mapped{};
 
-		void RotateY(float yaw)
-		{
-			rotationTransform = Matrix::CreateRotationY(yaw);
-		}
+		bool IsMapped() const { return mapped.pFile != nullptr; }
 
-		void Scale(const Vector3& scale)
+		//Arrays of the mesh wherever they live, use these instead of the vectors to read a mesh
+		std::span<const Vector3> GetPositions() const { return IsMapped() ? mapped.positions : std::span<const Vector3>{ positions }; }
+		std::span<const Vector3> GetNormals() const { return IsMapped() ? mapped.normals : std::span<const Vector3>{ normals }; }
+		std::span<const int> GetIndices() const { return IsMapped() ? mapped.indices : std::span<const int>{ indices }; }
+		std::span<const BVHNode> GetBVHNodes() const { return IsMapped() ? mapped.bvhNodes : std::span<const BVHNode>{ bvhNodes }; }
+		std::span<const TriangleBlock> GetTriangleBlocks() const { return IsMapped() ? mapped.triangleBlocks : std::span<const TriangleBlock>{ triangleBlocks }; }
+		std::span<const uint32_t> GetBVHLeafFirstBlock() const { return IsMapped() ? mapped.bvhLeafFirstBlock : std::span<const uint32_t>{ bvhLeafFirstBlock }; }
+
+		//Copies a mapped mesh into the vectors so it can be edited, every function that changes the mesh calls this first
+		void DetachFromCache()
 		{
-			scaleTransform = Matrix::CreateScale(scale);
+			if (!IsMapped())
+				return;
+
+			positions.assign(mapped.positions.begin(), mapped.positions.end());
+			normals.assign(mapped.normals.begin(), mapped.normals.end());
+			indices.assign(mapped.indices.begin(), mapped.indices.end());
+			bvhNodes.assign(mapped.bvhNodes.begin(), mapped.bvhNodes.end());
+			triangleBlocks.assign(mapped.triangleBlocks.begin(), mapped.triangleBlocks.end());
+			bvhLeafFirstBlock.assign(mapped.bvhLeafFirstBlock.begin(), mapped.bvhLeafFirstBlock.end());
+			mapped = {};
 		}
 
-		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
+		void AppendTriangle(const Triangle& triangle, bool ignoreBVHUpdate = false)
 		{
+			DetachFromCache();
+
 			int startIndex = static_cast<int>(positions.size());
 
 			positions.push_back(triangle.v0);
@@ -122,13 +207,17 @@ namespace dae
 
 			normals.push_back(triangle.normal);
 
-			//Not ideal, but making sure all vertices are updated
-			if (!ignoreTransformUpdate)
-				UpdateTransforms();
+			//Topology changed, the next BVH update has to rebuild
+			bvhNodes.clear();
+
+			if (!ignoreBVHUpdate)
+				UpdateBVH();
 		}
 
 		void CalculateNormals()
 		{
+			DetachFromCache();
+
 			//assert(false && "No Implemented Yet!");
 
 			//a=v1-v0
@@ -156,36 +245,84 @@ namespace dae
 			}
 		}
 
-		void UpdateTransforms()
+		//Call after changing positions. In Refit mode an existing tree is only refitted, which assumes the triangles stayed the same,
+		//clear bvhNodes after changing indices so it gets rebuilt. Instances don't notice: set isTransformDirty and call UpdateTransforms
+		//on every instance of the mesh so their world bounds follow and the scene rebuilds its BVH and traces a new frame
+		void UpdateBVH()
 		{
-			//assert(false && "No Implemented Yet!");
-			//Calculate Final Transform 
-			//const auto finalTransform = ...
+			DetachFromCache();
+			UpdateAABB();
 
-			//Transform Positions (positions > transformedPositions)
-			//...
+			if (bvhUpdateMode == BVHUpdateMode::Refit && !bvhNodes.empty())
+				RefitBVH();
+			else
+				BuildBVH();
 
-			//Transform Normals (normals > transformedNormals)
-			//...
-
-			//final transfrom = scale * rotation * transform
+			UpdateTriangleBlocks();
+		}
 
-			//transformedPositions = finalTransform * positions;
-			const auto finalTransform{ scaleTransform * rotationTransform * translationTransform };
+		void UpdateTriangleBlocks()
+		{
+			triangleBlocks.clear();
+			bvhLeafFirstBlock.assign(bvhNodes.size(), 0);
 
-			transformedPositions.clear();
-			for (const auto position : positions)
+			for (size_t nodeIndex{}; nodeIndex < bvhNodes.size(); ++nodeIndex)
 			{
-				transformedPositions.emplace_back(finalTransform.TransformPoint(position));
+				const BVHNode& node{ bvhNodes[nodeIndex] };
+				if (!node.IsLeaf())
+					continue;
+
+				bvhLeafFirstBlock[nodeIndex] = static_cast<uint32_t>(triangleBlocks.size());
+				for (uint32_t i{}; i < node.primitiveCount; ++i)
+				{
+					if (i % TRIANGLE_BLOCK_WIDTH == 0)
+						triangleBlocks.emplace_back();
+
+					const uint32_t triangleIndex{ node.leftFirst + i };
+					const Vector3& v0{ positions[indices[triangleIndex * 3]] };
+
+					PrecomputedTriangle triangle{};
+					triangle.v0 = v0;
+					triangle.edge1 = positions[indices[triangleIndex * 3 + 1]] - v0;
+					triangle.edge2 = positions[indices[triangleIndex * 3 + 2]] - v0;
+					triangle.normal = normals[triangleIndex];
+
+					triangleBlocks.back().SetTriangle(i % TRIANGLE_BLOCK_WIDTH, triangle);
+				}
 			}
+		}
 
-			UpdateTransformedAABB(finalTransform);
+		void BuildBVH()
+		{
+			std::vector<uint32_t> triangleOrder{};
+			BVH::Build(positions, indices, bvhNodes, triangleOrder, TRIANGLE_BLOCK_WIDTH);
 
-			transformedNormals.clear();
-			for (const auto normal : normals)
+			//Store the triangles in leaf order so every leaf is a contiguous range
+			const std::vector<int> oldIndices{ indices };
+			const std::vector<Vector3> oldNormals{ normals };
+			for (size_t i{}; i < triangleOrder.size(); ++i)
 			{
-				transformedNormals.emplace_back(finalTransform.TransformVector(normal));
+				const uint32_t triangleIndex{ triangleOrder[i] };
+				indices[i * 3] = oldIndices[triangleIndex * 3];
+				indices[i * 3 + 1] = oldIndices[triangleIndex * 3 + 1];
+				indices[i * 3 + 2] = oldIndices[triangleIndex * 3 + 2];
+
+				normals[i] = oldNormals[triangleIndex];
 			}
+
+			bvhBuildSAHCost = BVH::CalculateStats(bvhNodes).sahCost;
+		}
+
+		void RefitBVH()
+		{
+			const float sahCost{ BVH::Refit(positions, indices, bvhNodes) };
+			if (sahCost > bvhBuildSAHCost * BVH_REFIT_REBUILD_THRESHOLD)
+				BuildBVH();
+		}
+
+		BVHStats GetBVHStats() const
+		{
+			return BVH::CalculateStats(GetBVHNodes());
 		}
 
 		void UpdateAABB()
@@ -201,9 +338,87 @@ namespace dae
 				}
 			}
 		}
+	};
+
+	//Places a shared TriangleMesh in the world, rays are brought to object space instead of transforming the vertices
+	struct TriangleMeshInstance
+	{
+		const TriangleMesh* pMesh{ nullptr };
+		unsigned char materialIndex{};
+
+		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+
+		Matrix objectToWorld{};
+		Matrix worldToObject{};
+
+		Vector3 transformedMinAABB;
+		Vector3 transformedMaxAABB;
+
+		//Set when Translate, RotateY or Scale changed a transform, UpdateTransforms skips clean instances
+		bool isTransformDirty{ true };
+		//Set when UpdateTransforms moved the instance, cleared once the scene picked the move up
+		bool hasMoved{ false };
+
+		void Translate(const Vector3& translation)
+		{
+			SetTransform(translationTransform, Matrix::CreateTranslation(translation));
+		}
+
+		void RotateY(float yaw)
+		{
+			SetTransform(rotationTransform, Matrix::CreateRotationY(yaw));
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			SetTransform(scaleTransform, Matrix::CreateScale(scale));
+		}
+
+		void UpdateTransforms()
+		{
+			if (!isTransformDirty)
+				return;
+
+			TRACE_ZONE("TriangleMesh::UpdateTransforms");
+
+			//final transfrom = scale * rotation * transform
+			objectToWorld = scaleTransform * rotationTransform * translationTransform;
+			worldToObject = Matrix::Inverse(objectToWorld);
+
+			UpdateTransformedAABB(objectToWorld);
+
+			isTransformDirty = false;
+			hasMoved = true;
+		}
+
+		//Setting the transform an instance already has, e.g. the same yaw every frame, leaves it clean
+		void SetTransform(Matrix& transform, const Matrix& newTransform)
+		{
+			if (transform == newTransform)
+				return;
+
+			transform = newTransform;
+			isTransformDirty = true;
+		}
+
+		//Normals go through the inverse transpose so they stay perpendicular under non-uniform scaling
+		Vector3 TransformNormal(const Vector3& normal) const
+		{
+			return Vector3{
+				Vector3::Dot(worldToObject.GetAxisX(), normal),
+				Vector3::Dot(worldToObject.GetAxisY(), normal),
+				Vector3::Dot(worldToObject.GetAxisZ(), normal) }.Normalized();
+		}
 
 		void UpdateTransformedAABB(const Matrix& finalTransform)
 		{
+			const Vector3& minAABB{ pMesh->minAABB };
+			const Vector3& maxAABB{ pMesh->maxAABB };
+
 			Vector3 tMinAABB = finalTransform.TransformPoint(minAABB);
 			Vector3 tMaxAABB = tMinAABB;
 
@@ -276,5 +491,62 @@ namespace dae
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
+
+	//Primary rays are traced in packets covering RAY_PACKET_WIDTH x RAY_PACKET_HEIGHT pixels
+	constexpr uint32_t RAY_PACKET_WIDTH{ 4 };
+	constexpr uint32_t RAY_PACKET_HEIGHT{ 4 };
+	constexpr uint32_t RAY_PACKET_SIZE{ RAY_PACKET_WIDTH * RAY_PACKET_HEIGHT };
+	//Packets with fewer rays than this are traced one ray at a time
+	constexpr uint32_t RAY_PACKET_MIN_ACTIVE{ 4 };
+	static_assert(RAY_PACKET_SIZE % 4 == 0 && RAY_PACKET_SIZE <= 32, "Packets are processed 4 lanes at a time and tracked in a 32 bit mask");
+
+	//Structure of arrays bundle of rays, lanes are tested 4 at a time
+	struct alignas(16) RayPacket
+	{
+		float originX[RAY_PACKET_SIZE]{};
+		float originY[RAY_PACKET_SIZE]{};
+		float originZ[RAY_PACKET_SIZE]{};
+		float directionX[RAY_PACKET_SIZE]{};
+		float directionY[RAY_PACKET_SIZE]{};
+		float directionZ[RAY_PACKET_SIZE]{};
+		float min[RAY_PACKET_SIZE]{};
+		float max[RAY_PACKET_SIZE]{};
+
+		//Bit i is set when lane i carries a ray
+		uint32_t activeMask{};
+
+		void SetRay(uint32_t lane, const Ray& ray)
+		{
+			originX[lane] = ray.origin.x; originY[lane] = ray.origin.y; originZ[lane] = ray.origin.z;
+			directionX[lane] = ray.direction.x; directionY[lane] = ray.direction.y; directionZ[lane] = ray.direction.z;
+			min[lane] = ray.min;
+			max[lane] = ray.max;
+			activeMask |= 1u << lane;
+		}
+
+		Ray GetRay(uint32_t lane) const
+		{
+			return Ray{ { originX[lane], originY[lane], originZ[lane] }, { directionX[lane], directionY[lane], directionZ[lane] }, min[lane], max[lane] };
+		}
+
+		//A packet only pays off when its rays walk the BVH in the same order and there are enough of them
+		bool IsCoherent() const
+		{
+			if (std::popcount(activeMask) < static_cast<int>(RAY_PACKET_MIN_ACTIVE))
+				return false;
+
+			const uint32_t firstLane{ static_cast<uint32_t>(std::countr_zero(activeMask)) };
+			const bool negativeX{ directionX[firstLane] < 0.f };
+			const bool negativeY{ directionY[firstLane] < 0.f };
+			const bool negativeZ{ directionZ[firstLane] < 0.f };
+			for (uint32_t lanes{ activeMask }; lanes != 0; lanes &= lanes - 1)
+			{
+				const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(lanes)) };
+				if ((directionX[lane] < 0.f) != negativeX || (directionY[lane] < 0.f) != negativeY || (directionZ[lane] < 0.f) != negativeZ)
+					return false;
+			}
+			return true;
+		}
+	};
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+
+//Standard includes
+#include <algorithm>
+#include <immintrin.h>
+
+//Project includes
+#include "FrameBuffer.h"
+#include "ColorRGB.h"
+
+using namespace dae;
+
+FrameBuffer::FrameBuffer(int width, int height) :
+	m_pSurface(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888)),
+	m_Width(width),
+	m_Height(height)
+{
+	if (m_pSurface)
+	{
+		m_pPixels = static_cast<uint32_t*>(m_pSurface->pixels);
+		InitializeRadiance();
+	}
+}
+
+FrameBuffer::FrameBuffer(SDL_Window* pWindow) :
+	m_pWindow(pWindow),
+	m_pSurface(SDL_GetWindowSurface(pWindow))
+{
+	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
+	m_pPixels = static_cast<uint32_t*>(m_pSurface->pixels);
+	InitializeRadiance();
+}
+
+FrameBuffer::~FrameBuffer()
+{
+	//The window owns its surface
+	if (IsHeadless())
+		SDL_FreeSurface(m_pSurface);
+}
+
+uint32_t FrameBuffer::MapRGB(uint8_t r, uint8_t g, uint8_t b) const
+{
+	return SDL_MapRGB(m_pSurface->format, r, g, b);
+}
+
+void FrameBuffer::Resolve(int startX, int startY, int endX, int endY) const
+{
+	for (int py{ startY }; py < endY; ++py)
+	{
+		const size_t pixelIndex{ static_cast<size_t>(py) * m_Width + startX };
+		ResolveRow(m_Red.data() + pixelIndex, m_Green.data() + pixelIndex, m_Blue.data() + pixelIndex, m_pPixels + pixelIndex, endX - startX);
+	}
+}
+
+void FrameBuffer::ResolveScaled(int startX, int startY, int endX, int endY, int sourceWidth, int sourceHeight) const
+{
+	//Upscaled in chunks of a row so the packing can stay the one of Resolve
+	constexpr int chunkSize{ 64 };
+	float red[chunkSize];
+	float green[chunkSize];
+	float blue[chunkSize];
+
+	const float scaleX{ sourceWidth / static_cast<float>(m_Width) };
+	const float scaleY{ sourceHeight / static_cast<float>(m_Height) };
+
+	for (int py{ startY }; py < endY; ++py)
+	{
+		//Pixel centers line up, samples past the border are clamped to it
+		const float sourceY{ std::clamp((py + 0.5f) * scaleY - 0.5f, 0.f, sourceHeight - 1.f) };
+		const int y0{ static_cast<int>(sourceY) };
+		const int y1{ std::min(y0 + 1, sourceHeight - 1) };
+		const float weightY{ sourceY - y0 };
+		const size_t row0{ static_cast<size_t>(y0) * sourceWidth };
+		const size_t row1{ static_cast<size_t>(y1) * sourceWidth };
+
+		for (int chunkX{ startX }; chunkX < endX; chunkX += chunkSize)
+		{
+			const int count{ std::min(chunkSize, endX - chunkX) };
+			for (int i{}; i < count; ++i)
+			{
+				const float sourceX{ std::clamp((chunkX + i + 0.5f) * scaleX - 0.5f, 0.f, sourceWidth - 1.f) };
+				const int x0{ static_cast<int>(sourceX) };
+				const int x1{ std::min(x0 + 1, sourceWidth - 1) };
+				const float weightX{ sourceX - x0 };
+
+				const auto sample = [&](const std::vector<float>& plane)
+					{
+						const float top{ plane[row0 + x0] + (plane[row0 + x1] - plane[row0 + x0]) * weightX };
+						const float bottom{ plane[row1 + x0] + (plane[row1 + x1] - plane[row1 + x0]) * weightX };
+						return top + (bottom - top) * weightY;
+					};
+				red[i] = sample(m_Red);
+				green[i] = sample(m_Green);
+				blue[i] = sample(m_Blue);
+			}
+
+			ResolveRow(red, green, blue, m_pPixels + static_cast<size_t>(py) * m_Width + chunkX, count);
+		}
+	}
+}
+
+void FrameBuffer::ResolveRow(const float* pRed, const float* pGreen, const float* pBlue, uint32_t* pPixels, int count) const
+{
+	int px{};
+	if (m_IsPacked8888)
+	{
+		const __m128 one{ _mm_set1_ps(1.f) };
+		const __m128 channelMax{ _mm_set1_ps(255.f) };
+		const __m128i byteMask{ _mm_set1_epi32(0xFF) };
+		const __m128i redShift{ _mm_cvtsi32_si128(static_cast<int>(m_RedShift)) };
+		const __m128i greenShift{ _mm_cvtsi32_si128(static_cast<int>(m_GreenShift)) };
+		const __m128i blueShift{ _mm_cvtsi32_si128(static_cast<int>(m_BlueShift)) };
+		const __m128i alphaMask{ _mm_set1_epi32(static_cast<int>(m_AlphaMask)) };
+
+		for (; px + 4 <= count; px += 4)
+		{
+			__m128 red{ _mm_loadu_ps(pRed + px) };
+			__m128 green{ _mm_loadu_ps(pGreen + px) };
+			__m128 blue{ _mm_loadu_ps(pBlue + px) };
+
+			//MaxToOne, lanes that are not brighter than 1 are divided by 1
+			const __m128 maxValue{ _mm_max_ps(red, _mm_max_ps(green, blue)) };
+			const __m128 isTooBright{ _mm_cmpgt_ps(maxValue, one) };
+			const __m128 divisor{ _mm_or_ps(_mm_and_ps(isTooBright, maxValue), _mm_andnot_ps(isTooBright, one)) };
+			red = _mm_div_ps(red, divisor);
+			green = _mm_div_ps(green, divisor);
+			blue = _mm_div_ps(blue, divisor);
+
+			//Truncated and wrapped to a byte like a static_cast<uint8_t>
+			const __m128i redByte{ _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(red, channelMax)), byteMask) };
+			const __m128i greenByte{ _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(green, channelMax)), byteMask) };
+			const __m128i blueByte{ _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(blue, channelMax)), byteMask) };
+
+			const __m128i pixels{ _mm_or_si128(_mm_or_si128(_mm_sll_epi32(redByte, redShift), _mm_sll_epi32(greenByte, greenShift)),
+				_mm_or_si128(_mm_sll_epi32(blueByte, blueShift), alphaMask)) };
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + px), pixels);
+		}
+	}
+
+	//Leftover pixels of the row, or every pixel of a format that isn't 8 bits per channel
+	for (; px < count; ++px)
+	{
+		ColorRGB color{ pRed[px], pGreen[px], pBlue[px] };
+		color.MaxToOne();
+
+		pPixels[px] = MapRGB(
+			static_cast<uint8_t>(color.r * 255),
+			static_cast<uint8_t>(color.g * 255),
+			static_cast<uint8_t>(color.b * 255));
+	}
+}
+
+void FrameBuffer::Present() const
+{
+	if (!IsHeadless())
+		SDL_UpdateWindowSurface(m_pWindow);
+}
+
+bool FrameBuffer::SaveToBMP(const std::string& path) const
+{
+	return SDL_SaveBMP(m_pSurface, path.c_str()) == 0;
+}
+
+void FrameBuffer::InitializeRadiance()
+{
+	const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+	m_Red.assign(pixelCount, 0.f);
+	m_Green.assign(pixelCount, 0.f);
+	m_Blue.assign(pixelCount, 0.f);
+
+	const SDL_PixelFormat* pFormat{ m_pSurface->format };
+	m_IsPacked8888 = pFormat->BytesPerPixel == 4 && pFormat->Rloss == 0 && pFormat->Gloss == 0 && pFormat->Bloss == 0;
+	m_RedShift = pFormat->Rshift;
+	m_GreenShift = pFormat->Gshift;
+	m_BlueShift = pFormat->Bshift;
+	m_AlphaMask = pFormat->Amask;
+}
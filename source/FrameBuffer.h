@@ -0,0 +1,83 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	//32 bit pixels the renderer draws into, either the surface of a window or an in-memory surface when running headless.
+	//The renderer writes linear radiance into one float plane per channel, Resolve turns it into pixels
+	class FrameBuffer final
+	{
+	public:
+		//Headless buffer, no window or video subsystem needed
+		FrameBuffer(int width, int height);
+		//Draws straight into the surface of the window, Present() shows it
+		explicit FrameBuffer(SDL_Window* pWindow);
+		~FrameBuffer();
+
+		FrameBuffer(const FrameBuffer&) = delete;
+		FrameBuffer(FrameBuffer&&) noexcept = delete;
+		FrameBuffer& operator=(const FrameBuffer&) = delete;
+		FrameBuffer& operator=(FrameBuffer&&) noexcept = delete;
+
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		uint32_t* GetPixels() const { return m_pPixels; }
+		bool IsHeadless() const { return m_pWindow == nullptr; }
+
+		//Packs a color in the pixel format of the buffer
+		uint32_t MapRGB(uint8_t r, uint8_t g, uint8_t b) const;
+
+		//Linear radiance, pixel (px, py) is at index px + py * width of every plane
+		float* GetRed() { return m_Red.data(); }
+		float* GetGreen() { return m_Green.data(); }
+		float* GetBlue() { return m_Blue.data(); }
+
+		/**
+		 * \brief Tone maps the radiance of a rectangle and packs it into the pixels, 4 pixels at a time
+		 * Colors brighter than 1 are scaled down by their largest channel, like ColorRGB::MaxToOne.
+		 * Rectangles of different threads may be resolved at the same time
+		 */
+		void Resolve(int startX, int startY, int endX, int endY) const;
+		/**
+		 * \brief Like Resolve, but the radiance is a smaller image that gets bilinearly upscaled to the whole buffer
+		 * \param startX, startY, endX, endY rectangle of pixels to write
+		 * \param sourceWidth, sourceHeight size of the image in the planes, pixel (px, py) at index px + py * sourceWidth
+		 */
+		void ResolveScaled(int startX, int startY, int endX, int endY, int sourceWidth, int sourceHeight) const;
+
+		//Shows the pixels in the window, does nothing when headless
+		void Present() const;
+		//Returns false when the file couldn't be written
+		bool SaveToBMP(const std::string& path) const;
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pSurface{};
+		uint32_t* m_pPixels{};
+
+		int m_Width{};
+		int m_Height{};
+
+		std::vector<float> m_Red{};
+		std::vector<float> m_Green{};
+		std::vector<float> m_Blue{};
+
+		//8 bits per channel in a 32 bit pixel, Resolve packs those with shifts instead of going through SDL_MapRGB
+		bool m_IsPacked8888{};
+		uint32_t m_RedShift{};
+		uint32_t m_GreenShift{};
+		uint32_t m_BlueShift{};
+		uint32_t m_AlphaMask{};
+
+		void InitializeRadiance();
+		//Tone maps and packs count pixels from the planes into pPixels
+		void ResolveRow(const float* pRed, const float* pGreen, const float* pBlue, uint32_t* pPixels, int count) const;
+	};
+}
@@ -0,0 +1,86 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+
+		//The view keeps the mapping alive on its own, the handles are closed right away
+#if defined(_WIN32)
+		const HANDLE fileHandle{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		const HANDLE mappingHandle{ CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+		CloseHandle(fileHandle);
+		if (!mappingHandle)
+			return false;
+
+		const void* pView{ MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) };
+		CloseHandle(mappingHandle);
+		if (!pView)
+			return false;
+
+		m_pData = static_cast<const uint8_t*>(pView);
+		m_Size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		const int fileDescriptor{ open(path.c_str(), O_RDONLY) };
+		if (fileDescriptor < 0)
+			return false;
+
+		struct stat fileStatus {};
+		if (fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+		{
+			close(fileDescriptor);
+			return false;
+		}
+
+		void* pView{ mmap(nullptr, static_cast<size_t>(fileStatus.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0) };
+		close(fileDescriptor);
+		if (pView == MAP_FAILED)
+			return false;
+
+		m_pData = static_cast<const uint8_t*>(pView);
+		m_Size = static_cast<size_t>(fileStatus.st_size);
+#endif
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!m_pData)
+			return;
+
+#if defined(_WIN32)
+		UnmapViewOfFile(m_pData);
+#else
+		munmap(const_cast<uint8_t*>(m_pData), m_Size);
+#endif
+		m_pData = nullptr;
+		m_Size = 0;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Read-only memory mapping of a whole file, pages are only read from disk once they are touched
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//Maps path, an already open file is closed first. Returns false when the file is missing, empty or can't be mapped
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const { return m_pData != nullptr; }
+		const uint8_t* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const uint8_t* m_pData{};
+		size_t m_Size{};
+	};
+}
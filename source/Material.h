@@ -1,126 +1,121 @@
 #pragma once
+#include <cstdint>
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+#pragma region Material TYPE
+	enum class MaterialType : uint8_t
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence
 	};
 #pragma endregion
 
-#pragma region Material SOLID COLOR
-	//SOLID COLOR
-	//===========
-	class Material_SolidColor final : public Material
+#pragma region Material
+	//Flat material description stored by value in a table indexed by HitRecord::materialIndex.
+	//Everything that only depends on the material parameters is computed once by the Create functions,
+	//Shade switches on the type so every model can be inlined into the shading loop
+	struct Material
 	{
-	public:
-		Material_SolidColor(const ColorRGB& color): m_Color(color)
-		{
-		}
+		MaterialType type{ MaterialType::SolidColor };
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
-		{
-			return m_Color;
-		}
+		//Solid color, diffuse color or albedo depending on the type
+		ColorRGB color{ colors::White };
+		//Lambert and LambertPhong: the constant diffuse term
+		ColorRGB diffuse{};
 
-	private:
-		ColorRGB m_Color{colors::White};
-	};
-#pragma endregion
+		//LambertPhong
+		float specularReflectance{}; //ks
+		float phongExponent{ 1.f };
 
-#pragma region Material LAMBERT
-	//LAMBERT
-	//=======
-	class Material_Lambert final : public Material
-	{
-	public:
-		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
+		//CookTorrence
+		ColorRGB f0{};
+		bool isMetal{};
+		float alphaSquared{}; //GGX normal distribution, see BRDF::GetAlphaSquared_GGX
+		float k{}; //SchlickGGX geometry term, see BRDF::GetK_SchlickGGX
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		static Material CreateSolidColor(const ColorRGB& color)
 		{
-			//todo: W3
-			//assert(false && "Not Implemented Yet");
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			Material material{};
+			material.type = MaterialType::SolidColor;
+			material.color = color;
+			return material;
 		}
 
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{1.f}; //kd
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT PHONG
-	//LAMBERT-PHONG
-	//=============
-	class Material_LambertPhong final : public Material
-	{
-	public:
-		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent):
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
+		static Material CreateLambert(const ColorRGB& diffuseColor, float diffuseReflectance)
 		{
+			Material material{};
+			material.type = MaterialType::Lambert;
+			material.color = diffuseColor;
+			material.diffuse = BRDF::Lambert(diffuseReflectance, diffuseColor);
+			return material;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		static Material CreateLambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent)
 		{
-			//todo: W3
-			//assert(false && "Not Implemented Yet");
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) + 
-				BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, v, hitRecord.normal);
+			Material material{};
+			material.type = MaterialType::LambertPhong;
+			material.color = diffuseColor;
+			material.diffuse = BRDF::Lambert(kd, diffuseColor);
+			material.specularReflectance = ks;
+			material.phongExponent = phongExponent;
+			return material;
 		}
 
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{0.5f}; //kd
-		float m_SpecularReflectance{0.5f}; //ks
-		float m_PhongExponent{1.f}; //Phong Exponent
-	};
-#pragma endregion
-
-#pragma region Material COOK TORRENCE
-	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
-	{
-	public:
-		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness):
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
+		/**
+		 * \param albedo e.g. {0.955f, 0.637f, 0.538f} for copper
+		 * \param metalness 0 is a dielectric, anything else a metal
+		 * \param roughness [1.0 > 0.0] >> [ROUGH > SMOOTH]
+		 */
+		static Material CreateCookTorrence(const ColorRGB& albedo, float metalness, float roughness)
 		{
+			Material material{};
+			material.type = MaterialType::CookTorrence;
+			material.color = albedo;
+			material.isMetal = metalness != 0;
+			material.f0 = material.isMetal ? albedo : ColorRGB{ 0.04f, 0.04f, 0.04f };
+			material.alphaSquared = BRDF::GetAlphaSquared_GGX(roughness);
+			material.k = BRDF::GetK_SchlickGGX(roughness);
+			return material;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		/**
+		 * \brief Function used to calculate the correct color for the specific material and its parameters
+		 * \param hitRecord current hitrecord
+		 * \param l light direction
+		 * \param v view direction
+		 * \return color
+		 */
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
-			//todo: W3
-			//assert(false && "Not Implemented Yet");
-
-			ColorRGB f0{ (m_Metalness == 0) ? ColorRGB{ 0.04f, 0.04f, 0.04f } : m_Albedo };
+			switch (type)
+			{
+			case MaterialType::SolidColor:
+				return color;
+			case MaterialType::Lambert:
+				return diffuse;
+			case MaterialType::LambertPhong:
+				return diffuse + BRDF::Phong(specularReflectance, phongExponent, l, v, hitRecord.normal);
+			case MaterialType::CookTorrence:
+				return ShadeCookTorrence(hitRecord, l, v);
+			}
+
+			return {};
+		}
 
-			const auto halfVector{ (-v - l) / (-v - l).Magnitude() };
-			halfVector.Normalized();
+		ColorRGB ShadeCookTorrence(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
+		{
+			const Vector3 viewPlusLight{ -v - l };
+			const Vector3 halfVector{ viewPlusLight / viewPlusLight.Magnitude() };
 
 			const auto f{ BRDF::FresnelFunction_Schlick(halfVector, -v, f0) };
-			const auto d{ BRDF::NormalDistribution_GGX(hitRecord.normal, halfVector, m_Roughness) };
-			const auto g{ BRDF::GeometryFunction_Smith(hitRecord.normal, -v, -l, m_Roughness) };
+			const auto d{ BRDF::NormalDistribution_GGX_Precomputed(hitRecord.normal, halfVector, alphaSquared) };
+			const auto g{ BRDF::GeometryFunction_Smith_Precomputed(hitRecord.normal, -v, -l, k) };
 
 			const auto dotVN{ Vector3::Dot(-v, hitRecord.normal) };
 			const auto dotLN{ Vector3::Dot(-l, hitRecord.normal) };
@@ -128,19 +123,13 @@ namespace dae
 			const auto numerator{ (4 * dotVN * dotLN) };
 			ColorRGB specular{ dfg.r / numerator, dfg.g / numerator, dfg.b / numerator };
 
-			ColorRGB kd{ (m_Metalness == 0) ? ColorRGB{ 1 - f.r, 1 - f.g, 1 - f.b } : ColorRGB{ 0.f, 0.f, 0.f } };
-
-			const auto diffuse{ BRDF::Lambert(kd, m_Albedo) };
+			//Metals have no diffuse part
+			if (isMetal)
+				return specular;
 
-			const ColorRGB finalColour{ diffuse + specular };
-
-			return finalColour;
+			const auto diffuseColor{ BRDF::Lambert(ColorRGB{ 1 - f.r, 1 - f.g, 1 - f.b }, color) };
+			return diffuseColor + specular;
 		}
-
-	private:
-		ColorRGB m_Albedo{0.955f, 0.637f, 0.538f}; //Copper
-		float m_Metalness{1.0f};
-		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
 #pragma endregion
 }
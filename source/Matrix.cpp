@@ -82,6 +82,29 @@ namespace dae {
 		return out;
 	}
 
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		//Only handles affine matrices (last column 0,0,0,1), which is all the Create functions produce
+		const Vector3 xAxis{ m[0] };
+		const Vector3 yAxis{ m[1] };
+		const Vector3 zAxis{ m[2] };
+
+		//The inverse of the 3x3 part has the cross products of the rows as its columns
+		const Vector3 c0{ Vector3::Cross(yAxis, zAxis) };
+		const Vector3 c1{ Vector3::Cross(zAxis, xAxis) };
+		const Vector3 c2{ Vector3::Cross(xAxis, yAxis) };
+		const float invDeterminant{ 1.f / Vector3::Dot(xAxis, c0) };
+
+		Matrix out{
+			Vector3{ c0.x, c1.x, c2.x } * invDeterminant,
+			Vector3{ c0.y, c1.y, c2.y } * invDeterminant,
+			Vector3{ c0.z, c1.z, c2.z } * invDeterminant,
+			Vector3::Zero };
+
+		out[3] = Vector4{ -out.TransformVector(m.GetTranslation()), 1.f };
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -102,6 +125,12 @@ namespace dae {
 		return data[3];
 	}
 
+	const float* Matrix::GetData() const
+	{
+		static_assert(sizeof(Vector4) == 4 * sizeof(float), "Rows have to be tightly packed");
+		return &data[0].x;
+	}
+
 	Matrix Matrix::CreateTranslation(float x, float y, float z)
 	{
 		//todo W1
@@ -238,5 +267,19 @@ namespace dae {
 
 		return *this;
 	}
+
+	bool Matrix::operator==(const Matrix& m) const
+	{
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				if (data[r][c] != m.data[r][c])
+					return false;
+			}
+		}
+
+		return true;
+	}
 #pragma endregion
 }
\ No newline at end of file
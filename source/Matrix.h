@@ -30,6 +30,8 @@ namespace dae {
 		Vector3 GetAxisY() const;
 		Vector3 GetAxisZ() const;
 		Vector3 GetTranslation() const;
+		//The 4 rows as 16 contiguous floats, e.g. to load them into SIMD registers
+		const float* GetData() const;
 
 		static Matrix CreateTranslation(float x, float y, float z);
 		static Matrix CreateTranslation(const Vector3& t);
@@ -41,11 +43,14 @@ namespace dae {
 		static Matrix CreateScale(float sx, float sy, float sz);
 		static Matrix CreateScale(const Vector3& s);
 		static Matrix Transpose(const Matrix& m);
+		static Matrix Inverse(const Matrix& m);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
+		//Exact comparison, e.g. to tell whether a transform really changed
+		bool operator==(const Matrix& m) const;
 
 	private:
 
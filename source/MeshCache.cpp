@@ -0,0 +1,254 @@
+#include "MeshCache.h"
+
+//Standard includes
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+//Project includes
+#include "MappedFile.h"
+#include "OBJParser.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr char MESH_CACHE_MAGIC[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+		//Bump when the format or anything baked into it changes, e.g. the BVH builder or the block layout
+		constexpr uint32_t MESH_CACHE_VERSION{ 2 };
+		//Every blob starts on a cache line, which also covers the 32 byte alignment of TriangleBlock
+		constexpr uint64_t MESH_CACHE_ALIGNMENT{ 64 };
+
+		enum MeshCacheBlob : uint32_t
+		{
+			Positions,
+			Normals,
+			Indices,
+			BVHNodes,
+			TriangleBlocks,
+			BVHLeafFirstBlock,
+			BlobCount
+		};
+
+		struct BlobRange
+		{
+			uint64_t offset{};
+			uint64_t count{};
+		};
+
+		struct MeshCacheHeader
+		{
+			char magic[8]{};
+			uint32_t version{};
+
+			//Layout of the stored structs, a cache written by a build with other structs is rebuilt instead of misread
+			uint32_t vector3Size{};
+			uint32_t bvhNodeSize{};
+			uint32_t triangleBlockSize{};
+			uint32_t triangleBlockWidth{};
+			uint32_t reserved{};
+
+			uint64_t sourceSize{};
+			uint64_t sourceHash{};
+
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			float bvhBuildSAHCost{};
+			uint32_t reserved2{};
+
+			BlobRange blobs[BlobCount]{};
+		};
+
+		static_assert(std::is_trivially_copyable_v<Vector3> && std::is_trivially_copyable_v<BVHNode> && std::is_trivially_copyable_v<TriangleBlock>,
+			"Mesh cache blobs are written and mapped as raw bytes");
+
+		uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+		}
+
+		//Points span at a blob of the mapped file, fails when the blob doesn't fit inside the file
+		template<typename T>
+		bool GetBlob(const MappedFile& file, const BlobRange& range, std::span<const T>& span)
+		{
+			if (range.offset % alignof(T) != 0 || range.offset > file.GetSize() || range.count > (file.GetSize() - range.offset) / sizeof(T))
+				return false;
+
+			span = { reinterpret_cast<const T*>(file.GetData() + range.offset), static_cast<size_t>(range.count) };
+			return true;
+		}
+
+		template<typename T>
+		void WriteBlob(std::ofstream& fileStream, const BlobRange& range, std::span<const T> data)
+		{
+			//Zero padding up to the aligned start of the blob
+			const char padding[MESH_CACHE_ALIGNMENT]{};
+			fileStream.write(padding, static_cast<std::streamsize>(range.offset - static_cast<uint64_t>(fileStream.tellp())));
+			fileStream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size_bytes()));
+		}
+	}
+
+	bool MeshCache::LoadOBJ(const std::string& objPath, TriangleMesh& mesh)
+	{
+		TRACE_ZONE("MeshCache::LoadOBJ");
+
+		MappedFile objFile{};
+		if (!objFile.Open(objPath))
+			return false;
+
+		const uint64_t sourceHash{ HashBytes(objFile.GetData(), objFile.GetSize()) };
+		const uint64_t sourceSize{ objFile.GetSize() };
+
+		const std::string cachePath{ GetCachePath(objPath) };
+		if (Read(cachePath, sourceHash, sourceSize, mesh))
+			return true;
+
+		//Parsed straight from the mapping that was just hashed
+		OBJData data{};
+		if (!OBJParser::Parse(reinterpret_cast<const char*>(objFile.GetData()), objFile.GetSize(), data))
+			return false;
+		objFile.Close();
+
+		mesh.positions = std::move(data.positions);
+		mesh.indices = std::move(data.positionIndices);
+		mesh.normals.clear();
+		mesh.CalculateNormals();
+		mesh.UpdateBVH();
+
+		//Without a cache the next startup just parses again
+		if (!Write(cachePath, mesh, sourceHash, sourceSize))
+			std::cout << "Could not write mesh cache " << cachePath << "\n";
+
+		return true;
+	}
+
+	bool MeshCache::Read(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, TriangleMesh& mesh)
+	{
+		std::shared_ptr<MappedFile> pFile{ std::make_shared<MappedFile>() };
+		if (!pFile->Open(cachePath) || pFile->GetSize() < sizeof(MeshCacheHeader))
+			return false;
+
+		MeshCacheHeader header{};
+		std::memcpy(&header, pFile->GetData(), sizeof(header));
+
+		if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 || header.version != MESH_CACHE_VERSION
+			|| header.vector3Size != sizeof(Vector3) || header.bvhNodeSize != sizeof(BVHNode)
+			|| header.triangleBlockSize != sizeof(TriangleBlock) || header.triangleBlockWidth != TRIANGLE_BLOCK_WIDTH
+			|| header.sourceSize != sourceSize || header.sourceHash != sourceHash)
+			return false;
+
+		MappedMeshData mapped{};
+		if (!GetBlob(*pFile, header.blobs[Positions], mapped.positions)
+			|| !GetBlob(*pFile, header.blobs[Normals], mapped.normals)
+			|| !GetBlob(*pFile, header.blobs[Indices], mapped.indices)
+			|| !GetBlob(*pFile, header.blobs[BVHNodes], mapped.bvhNodes)
+			|| !GetBlob(*pFile, header.blobs[TriangleBlocks], mapped.triangleBlocks)
+			|| !GetBlob(*pFile, header.blobs[BVHLeafFirstBlock], mapped.bvhLeafFirstBlock))
+			return false;
+
+		if (mapped.indices.size() != mapped.normals.size() * 3 || mapped.bvhLeafFirstBlock.size() != mapped.bvhNodes.size() || mapped.bvhNodes.empty())
+			return false;
+
+		mapped.pFile = std::move(pFile);
+
+		mesh.positions.clear();
+		mesh.normals.clear();
+		mesh.indices.clear();
+		mesh.bvhNodes.clear();
+		mesh.triangleBlocks.clear();
+		mesh.bvhLeafFirstBlock.clear();
+		mesh.mapped = std::move(mapped);
+
+		mesh.minAABB = header.minAABB;
+		mesh.maxAABB = header.maxAABB;
+		mesh.bvhBuildSAHCost = header.bvhBuildSAHCost;
+		return true;
+	}
+
+	bool MeshCache::Write(const std::string& cachePath, const TriangleMesh& mesh, uint64_t sourceHash, uint64_t sourceSize)
+	{
+		MeshCacheHeader header{};
+		std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+		header.version = MESH_CACHE_VERSION;
+		header.vector3Size = sizeof(Vector3);
+		header.bvhNodeSize = sizeof(BVHNode);
+		header.triangleBlockSize = sizeof(TriangleBlock);
+		header.triangleBlockWidth = TRIANGLE_BLOCK_WIDTH;
+		header.sourceSize = sourceSize;
+		header.sourceHash = sourceHash;
+		header.minAABB = mesh.minAABB;
+		header.maxAABB = mesh.maxAABB;
+		header.bvhBuildSAHCost = mesh.bvhBuildSAHCost;
+
+		uint64_t offset{ AlignOffset(sizeof(MeshCacheHeader)) };
+		const auto placeBlob = [&](MeshCacheBlob blob, size_t count, size_t elementSize)
+			{
+				header.blobs[blob] = { offset, count };
+				offset = AlignOffset(offset + count * elementSize);
+			};
+		placeBlob(Positions, mesh.GetPositions().size(), sizeof(Vector3));
+		placeBlob(Normals, mesh.GetNormals().size(), sizeof(Vector3));
+		placeBlob(Indices, mesh.GetIndices().size(), sizeof(int));
+		placeBlob(BVHNodes, mesh.GetBVHNodes().size(), sizeof(BVHNode));
+		placeBlob(TriangleBlocks, mesh.GetTriangleBlocks().size(), sizeof(TriangleBlock));
+		placeBlob(BVHLeafFirstBlock, mesh.GetBVHLeafFirstBlock().size(), sizeof(uint32_t));
+
+		//Written under a temporary name and renamed, so a crash never leaves a half written cache behind
+		const std::string temporaryPath{ cachePath + ".tmp" };
+		{
+			std::ofstream fileStream{ temporaryPath, std::ios::binary | std::ios::trunc };
+			if (!fileStream)
+				return false;
+
+			fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			WriteBlob(fileStream, header.blobs[Positions], mesh.GetPositions());
+			WriteBlob(fileStream, header.blobs[Normals], mesh.GetNormals());
+			WriteBlob(fileStream, header.blobs[Indices], mesh.GetIndices());
+			WriteBlob(fileStream, header.blobs[BVHNodes], mesh.GetBVHNodes());
+			WriteBlob(fileStream, header.blobs[TriangleBlocks], mesh.GetTriangleBlocks());
+			WriteBlob(fileStream, header.blobs[BVHLeafFirstBlock], mesh.GetBVHLeafFirstBlock());
+
+			if (!fileStream.good())
+			{
+				fileStream.close();
+				std::filesystem::remove(temporaryPath);
+				return false;
+			}
+		}
+
+		std::error_code errorCode{};
+		std::filesystem::rename(temporaryPath, cachePath, errorCode);
+		if (errorCode)
+		{
+			std::filesystem::remove(temporaryPath, errorCode);
+			return false;
+		}
+		return true;
+	}
+
+	std::string MeshCache::GetCachePath(const std::string& objPath)
+	{
+		return objPath + ".meshcache";
+	}
+
+	uint64_t MeshCache::HashBytes(const uint8_t* pData, size_t size)
+	{
+		constexpr uint64_t offsetBasis{ 14695981039346656037ull };
+		constexpr uint64_t prime{ 1099511628211ull };
+
+		uint64_t hash{ offsetBasis ^ size };
+		size_t byteIndex{};
+		for (; byteIndex + sizeof(uint64_t) <= size; byteIndex += sizeof(uint64_t))
+		{
+			uint64_t word{};
+			std::memcpy(&word, pData + byteIndex, sizeof(word));
+			hash = (hash ^ word) * prime;
+		}
+		for (; byteIndex < size; ++byteIndex)
+			hash = (hash ^ pData[byteIndex]) * prime;
+
+		return hash;
+	}
+}
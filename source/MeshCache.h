@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Binary copy of a parsed OBJ with its BVH and triangle blocks, stored next to the OBJ as <name>.obj.meshcache.
+	//Loading one maps the file and points the mesh at it, nothing is parsed, built or copied
+	namespace MeshCache
+	{
+		/**
+		 * \brief Loads an OBJ through its cache, parses the OBJ and writes a new cache when there is no valid one
+		 * \param objPath OBJ file, its contents are hashed on every load so an edited OBJ never loads a stale cache
+		 * \param mesh empty mesh, a mesh loaded from the cache reads the mapped file until it is edited
+		 * \return false when the OBJ can't be read
+		 */
+		bool LoadOBJ(const std::string& objPath, TriangleMesh& mesh);
+
+		/**
+		 * \brief Maps a cache and attaches it to mesh
+		 * \param sourceHash hash of the OBJ the cache has to be written from, see HashBytes
+		 * \param sourceSize size in bytes of that OBJ
+		 * \return false when the cache is missing, belongs to another OBJ or was written with a different data layout
+		 */
+		bool Read(const std::string& cachePath, uint64_t sourceHash, uint64_t sourceSize, TriangleMesh& mesh);
+
+		//Writes mesh with its BVH as a cache of the OBJ with sourceHash and sourceSize, returns false when the file couldn't be written
+		bool Write(const std::string& cachePath, const TriangleMesh& mesh, uint64_t sourceHash, uint64_t sourceSize);
+
+		std::string GetCachePath(const std::string& objPath);
+		//64 bit FNV-1a over 8 byte words, fast enough to run over a large OBJ on every startup
+		uint64_t HashBytes(const uint8_t* pData, size_t size);
+	}
+}
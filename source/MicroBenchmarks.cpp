@@ -0,0 +1,599 @@
+//Standalone timings of the intersection and BRDF kernels, no window, scene or thread pool involved
+//Every kernel runs over the same fixed-seed ray/primitive sets, so runs on one machine can be compared directly
+
+//Standard includes
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "BRDFs.h"
+#include "TriangleKernels.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	//Primitives per set, every primitive is tested against one full packet of rays
+	constexpr uint32_t PRIMITIVE_COUNT{ 1024 };
+	constexpr uint32_t RAY_COUNT{ PRIMITIVE_COUNT * RAY_PACKET_SIZE };
+	constexpr uint32_t RANDOM_SEED{ 1337 };
+
+	const uint32_t HIT_PERCENTAGES[]{ 0, 50, 100 };
+
+	struct MicroBenchmarkSettings
+	{
+		//A repetition runs whole passes over the set until at least this much time went by, the fastest repetition is reported
+		double minRepetitionMilliseconds{ 50.0 };
+		uint32_t repetitionCount{ 5 };
+		//Only kernels whose name contains this text are run
+		std::string filter{};
+	};
+
+	//Primitive with the rays that are tested against it, the packet holds the same rays as the array
+	template<typename Primitive>
+	struct TestCase
+	{
+		Primitive primitive{};
+		Ray rays[RAY_PACKET_SIZE]{};
+		RayPacket packet{};
+		Vector3 invDirections[RAY_PACKET_SIZE]{};
+		alignas(16) float packetInvDirection[3][RAY_PACKET_SIZE]{};
+	};
+
+	//Shading inputs of one BRDF evaluation
+	struct BRDFCase
+	{
+		Vector3 n{};
+		Vector3 l{};
+		Vector3 v{};
+		Vector3 h{};
+		float roughness{};
+		ColorRGB f0{};
+	};
+
+	//Kept out of reach of the optimizer, every kernel writes its results here
+	volatile uint64_t g_HitSink{};
+	volatile float g_ShadeSink{};
+
+	class RandomGenerator final
+	{
+	public:
+		explicit RandomGenerator(uint32_t seed) :
+			m_Engine(seed)
+		{
+		}
+
+		float Float(float min, float max)
+		{
+			return std::uniform_real_distribution<float>{ min, max }(m_Engine);
+		}
+
+		Vector3 Point(float extent)
+		{
+			return { Float(-extent, extent), Float(-extent, extent), Float(-extent, extent) };
+		}
+
+		Vector3 UnitVector()
+		{
+			//Rejection sampling keeps the directions uniform
+			while (true)
+			{
+				const Vector3 point{ Point(1.f) };
+				const float sqrMagnitude{ point.SqrMagnitude() };
+				if (sqrMagnitude > 0.0001f && sqrMagnitude <= 1.f)
+					return point / std::sqrt(sqrMagnitude);
+			}
+		}
+
+		//Random unit vector orthogonal to direction
+		Vector3 Perpendicular(const Vector3& direction)
+		{
+			while (true)
+			{
+				const Vector3 perpendicular{ Vector3::Reject(UnitVector(), direction) };
+				if (perpendicular.SqrMagnitude() > 0.0001f)
+					return perpendicular.Normalized();
+			}
+		}
+
+		//Exactly hitPercentage percent of count flags are set, in random order so the branch predictor can't learn them
+		std::vector<bool> HitFlags(uint32_t count, uint32_t hitPercentage)
+		{
+			std::vector<bool> flags(count, false);
+			std::fill_n(flags.begin(), count * hitPercentage / 100, true);
+			std::shuffle(flags.begin(), flags.end(), m_Engine);
+			return flags;
+		}
+
+	private:
+		std::mt19937 m_Engine;
+	};
+
+#pragma region Test Sets
+	Ray CreateRay(const Vector3& origin, const Vector3& target)
+	{
+		return Ray{ origin, (target - origin).Normalized() };
+	}
+
+	//Target that the ray from origin passes at least 2.4 * extent away from center, outside any primitive of that extent
+	Vector3 GetMissTarget(RandomGenerator& random, const Vector3& center, const Vector3& origin, float extent)
+	{
+		return center + random.Perpendicular(origin - center) * (3.f * extent);
+	}
+
+	template<typename Primitive, typename CreatePrimitive, typename CreateRayFunction>
+	std::vector<TestCase<Primitive>> CreateTestSet(uint32_t hitPercentage, const CreatePrimitive& createPrimitive, const CreateRayFunction& createRay)
+	{
+		RandomGenerator random{ RANDOM_SEED + hitPercentage };
+		const std::vector<bool> hitFlags{ random.HitFlags(RAY_COUNT, hitPercentage) };
+
+		std::vector<TestCase<Primitive>> testSet(PRIMITIVE_COUNT);
+		for (uint32_t primitiveIndex{}; primitiveIndex < PRIMITIVE_COUNT; ++primitiveIndex)
+		{
+			TestCase<Primitive>& testCase{ testSet[primitiveIndex] };
+			testCase.primitive = createPrimitive(random);
+
+			for (uint32_t lane{}; lane < RAY_PACKET_SIZE; ++lane)
+			{
+				const Ray ray{ createRay(random, testCase.primitive, hitFlags[primitiveIndex * RAY_PACKET_SIZE + lane]) };
+				testCase.rays[lane] = ray;
+				testCase.packet.SetRay(lane, ray);
+
+				testCase.invDirections[lane] = { 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+				testCase.packetInvDirection[0][lane] = testCase.invDirections[lane].x;
+				testCase.packetInvDirection[1][lane] = testCase.invDirections[lane].y;
+				testCase.packetInvDirection[2][lane] = testCase.invDirections[lane].z;
+			}
+		}
+		return testSet;
+	}
+
+	std::vector<TestCase<Sphere>> CreateSphereSet(uint32_t hitPercentage)
+	{
+		return CreateTestSet<Sphere>(hitPercentage,
+			[](RandomGenerator& random) { return Sphere{ random.Point(10.f), random.Float(0.5f, 1.f) }; },
+			[](RandomGenerator& random, const Sphere& sphere, bool isHit)
+			{
+				const Vector3 origin{ sphere.origin + random.UnitVector() * random.Float(4.f, 6.f) };
+				if (isHit)
+					return CreateRay(origin, sphere.origin + random.UnitVector() * (sphere.radius * random.Float(0.f, 0.9f)));
+				return CreateRay(origin, GetMissTarget(random, sphere.origin, origin, sphere.radius));
+			});
+	}
+
+	std::vector<TestCase<Plane>> CreatePlaneSet(uint32_t hitPercentage)
+	{
+		return CreateTestSet<Plane>(hitPercentage,
+			[](RandomGenerator& random) { return Plane{ random.Point(10.f), random.UnitVector() }; },
+			[](RandomGenerator& random, const Plane& plane, bool isHit)
+			{
+				const Vector3 tangent{ random.Perpendicular(plane.normal) };
+				const Vector3 origin{ plane.origin + plane.normal * random.Float(1.f, 5.f) + tangent * random.Float(-5.f, 5.f) };
+				const Vector3 target{ plane.origin + random.Perpendicular(plane.normal) * random.Float(0.f, 5.f) };
+				//Pointing away from the plane is the only way to miss an infinite plane
+				return isHit ? CreateRay(origin, target) : CreateRay(origin, origin * 2.f - target);
+			});
+	}
+
+	PrecomputedTriangle CreateTriangle(RandomGenerator& random, const Vector3& center)
+	{
+		const Vector3 v0{ center + random.UnitVector() * random.Float(0.5f, 1.f) };
+		const Vector3 v1{ center + random.UnitVector() * random.Float(0.5f, 1.f) };
+		const Vector3 v2{ center + random.UnitVector() * random.Float(0.5f, 1.f) };
+		return PrecomputedTriangle{ v0, v1 - v0, v2 - v0, Vector3::Cross(v1 - v0, v2 - v0).Normalized() };
+	}
+
+	//Point inside the triangle, away from its edges so rounding can't turn it into a miss
+	Vector3 GetPointInTriangle(RandomGenerator& random, const PrecomputedTriangle& triangle)
+	{
+		const float u{ random.Float(0.05f, 0.85f) };
+		const float v{ random.Float(0.05f, 0.9f - u) };
+		return triangle.v0 + triangle.edge1 * u + triangle.edge2 * v;
+	}
+
+	std::vector<TestCase<PrecomputedTriangle>> CreateTriangleSet(uint32_t hitPercentage)
+	{
+		return CreateTestSet<PrecomputedTriangle>(hitPercentage,
+			[](RandomGenerator& random) { return CreateTriangle(random, random.Point(10.f)); },
+			[](RandomGenerator& random, const PrecomputedTriangle& triangle, bool isHit)
+			{
+				const Vector3 centroid{ triangle.v0 + (triangle.edge1 + triangle.edge2) / 3.f };
+				const Vector3 origin{ centroid + random.UnitVector() * random.Float(4.f, 6.f) };
+				if (isHit)
+					return CreateRay(origin, GetPointInTriangle(random, triangle));
+
+				//Just outside the far edge, the ray gets through the edge tests before it's rejected
+				const float u{ random.Float(0.6f, 1.f) };
+				const float v{ random.Float(1.2f - u, 1.6f - u) };
+				return CreateRay(origin, triangle.v0 + triangle.edge1 * u + triangle.edge2 * v);
+			});
+	}
+
+	//All triangles of a block lie within 1 of the block center
+	struct TriangleBlockPrimitive
+	{
+		TriangleBlock block{};
+		Vector3 center{};
+	};
+
+	std::vector<TestCase<TriangleBlockPrimitive>> CreateTriangleBlockSet(uint32_t hitPercentage)
+	{
+		return CreateTestSet<TriangleBlockPrimitive>(hitPercentage,
+			[](RandomGenerator& random)
+			{
+				TriangleBlockPrimitive primitive{};
+				primitive.center = random.Point(10.f);
+				for (uint32_t lane{}; lane < TRIANGLE_BLOCK_WIDTH; ++lane)
+					primitive.block.SetTriangle(lane, CreateTriangle(random, primitive.center));
+				return primitive;
+			},
+			[](RandomGenerator& random, const TriangleBlockPrimitive& primitive, bool isHit)
+			{
+				const Vector3 origin{ primitive.center + random.UnitVector() * random.Float(4.f, 6.f) };
+				if (isHit)
+				{
+					const uint32_t lane{ static_cast<uint32_t>(random.Float(0.f, static_cast<float>(TRIANGLE_BLOCK_WIDTH))) % TRIANGLE_BLOCK_WIDTH };
+					return CreateRay(origin, GetPointInTriangle(random, primitive.block.GetTriangle(lane)));
+				}
+				return CreateRay(origin, GetMissTarget(random, primitive.center, origin, 1.f));
+			});
+	}
+
+	//Box with half extents up to 1, both slab tests read it from their own type
+	struct BoxPrimitive
+	{
+		TriangleMeshInstance instance{};
+		BVHNode node{};
+		Vector3 center{};
+		Vector3 halfExtents{};
+	};
+
+	std::vector<TestCase<BoxPrimitive>> CreateBoxSet(uint32_t hitPercentage)
+	{
+		return CreateTestSet<BoxPrimitive>(hitPercentage,
+			[](RandomGenerator& random)
+			{
+				BoxPrimitive primitive{};
+				primitive.center = random.Point(10.f);
+				primitive.halfExtents = { random.Float(0.25f, 1.f), random.Float(0.25f, 1.f), random.Float(0.25f, 1.f) };
+				primitive.instance.transformedMinAABB = primitive.center - primitive.halfExtents;
+				primitive.instance.transformedMaxAABB = primitive.center + primitive.halfExtents;
+				primitive.node.minAABB = primitive.instance.transformedMinAABB;
+				primitive.node.maxAABB = primitive.instance.transformedMaxAABB;
+				return primitive;
+			},
+			[](RandomGenerator& random, const BoxPrimitive& primitive, bool isHit)
+			{
+				const Vector3 origin{ primitive.center + random.UnitVector() * random.Float(4.f, 6.f) };
+				if (isHit)
+				{
+					const Vector3& halfExtents{ primitive.halfExtents };
+					const Vector3 offset{ halfExtents.x * random.Float(-0.9f, 0.9f), halfExtents.y * random.Float(-0.9f, 0.9f), halfExtents.z * random.Float(-0.9f, 0.9f) };
+					return CreateRay(origin, primitive.center + offset);
+				}
+				return CreateRay(origin, GetMissTarget(random, primitive.center, origin, std::sqrt(3.f)));
+			});
+	}
+
+	std::vector<BRDFCase> CreateBRDFSet()
+	{
+		RandomGenerator random{ RANDOM_SEED };
+
+		std::vector<BRDFCase> brdfSet(RAY_COUNT);
+		for (BRDFCase& brdfCase : brdfSet)
+		{
+			//Light and view in the hemisphere of the normal, like every shaded hit
+			brdfCase.n = random.UnitVector();
+			brdfCase.l = random.UnitVector();
+			if (Vector3::Dot(brdfCase.n, brdfCase.l) < 0.f)
+				brdfCase.l = -brdfCase.l;
+			brdfCase.v = random.UnitVector();
+			if (Vector3::Dot(brdfCase.n, brdfCase.v) < 0.f)
+				brdfCase.v = -brdfCase.v;
+			brdfCase.h = (brdfCase.l + brdfCase.v).Normalized();
+			brdfCase.roughness = random.Float(0.1f, 1.f);
+			brdfCase.f0 = { random.Float(0.04f, 1.f), random.Float(0.04f, 1.f), random.Float(0.04f, 1.f) };
+		}
+		return brdfSet;
+	}
+#pragma endregion
+
+#pragma region Measuring
+	//One pass runs a kernel over its whole set and returns how many rays hit, BRDF passes return 0
+	struct Kernel
+	{
+		std::string name{};
+		std::string variant{};
+		//-1 for kernels without a hit ratio
+		int hitPercentage{ -1 };
+		uint64_t testsPerPass{};
+		uint64_t raysPerPass{};
+		std::function<uint64_t()> pass{};
+		//Triangle block kernel to select before measuring
+		std::optional<TriangleKernel> triangleKernel{};
+	};
+
+	void Measure(const Kernel& kernel, const MicroBenchmarkSettings& settings)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		//Warms the caches and tells how many rays hit
+		const uint64_t hitCount{ kernel.pass() };
+		g_HitSink = g_HitSink + hitCount;
+
+		double bestNanosecondsPerTest{ DBL_MAX };
+		for (uint32_t repetition{}; repetition < settings.repetitionCount; ++repetition)
+		{
+			uint64_t passCount{};
+			double elapsedNanoseconds{};
+			const Clock::time_point start{ Clock::now() };
+			do
+			{
+				g_HitSink = g_HitSink + kernel.pass();
+				++passCount;
+				elapsedNanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			} while (elapsedNanoseconds < settings.minRepetitionMilliseconds * 1e6);
+
+			bestNanosecondsPerTest = std::min(bestNanosecondsPerTest, elapsedNanoseconds / (passCount * kernel.testsPerPass));
+		}
+
+		std::cout << std::left << std::setw(34) << kernel.name << std::setw(8) << kernel.variant << std::right << std::setw(6);
+		if (kernel.hitPercentage >= 0)
+			std::cout << (std::to_string(kernel.hitPercentage) + "%");
+		else
+			std::cout << "-";
+		std::cout << std::setw(12) << bestNanosecondsPerTest << std::setw(14) << 1e3 / bestNanosecondsPerTest;
+		if (kernel.hitPercentage >= 0)
+			std::cout << std::setw(12) << hitCount * 100.0 / kernel.raysPerPass << "%";
+		std::cout << "\n";
+	}
+#pragma endregion
+
+#pragma region Kernels
+	template<typename Primitive, typename TestFunction>
+	Kernel CreateRayKernel(const std::string& name, const std::string& variant, uint32_t hitPercentage, uint32_t testsPerRay,
+		const std::vector<TestCase<Primitive>>& testSet, const TestFunction& testFunction)
+	{
+		return Kernel{ name, variant, static_cast<int>(hitPercentage), uint64_t{ RAY_COUNT } * testsPerRay, RAY_COUNT,
+			[&testSet, testFunction]
+			{
+				uint64_t hitCount{};
+				for (const TestCase<Primitive>& testCase : testSet)
+					for (uint32_t lane{}; lane < RAY_PACKET_SIZE; ++lane)
+						hitCount += testFunction(testCase, lane) ? 1 : 0;
+				return hitCount;
+			} };
+	}
+
+	template<typename Primitive, typename TestFunction>
+	Kernel CreatePacketKernel(const std::string& name, uint32_t hitPercentage, const std::vector<TestCase<Primitive>>& testSet, const TestFunction& testFunction)
+	{
+		return Kernel{ name, "SSE", static_cast<int>(hitPercentage), RAY_COUNT, RAY_COUNT,
+			[&testSet, testFunction]
+			{
+				uint64_t hitCount{};
+				for (const TestCase<Primitive>& testCase : testSet)
+					hitCount += std::popcount(testFunction(testCase));
+				return hitCount;
+			} };
+	}
+
+	template<typename ShadeFunction>
+	Kernel CreateBRDFKernel(const std::string& name, const std::vector<BRDFCase>& brdfSet, const ShadeFunction& shadeFunction)
+	{
+		return Kernel{ name, "Scalar", -1, brdfSet.size(), brdfSet.size(),
+			[&brdfSet, shadeFunction]
+			{
+				float sum{};
+				for (const BRDFCase& brdfCase : brdfSet)
+					sum += shadeFunction(brdfCase);
+				g_ShadeSink = g_ShadeSink + sum;
+				return uint64_t{};
+			} };
+	}
+
+	float Sum(const ColorRGB& color)
+	{
+		return color.r + color.g + color.b;
+	}
+#pragma endregion
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: MicroBenchmarks [options]\n"
+			<< "  --filter <text>      only run kernels whose name contains text\n"
+			<< "  --time <ms>          minimum duration of one repetition, default 50\n"
+			<< "  --repetitions <n>    repetitions per kernel, the fastest one is reported, default 5\n";
+	}
+
+	bool ParseArguments(int argc, char* args[], MicroBenchmarkSettings& settings)
+	{
+		for (int i{ 1 }; i < argc; ++i)
+		{
+			const std::string argument{ args[i] };
+			const bool hasValue{ i + 1 < argc };
+
+			if (argument == "--filter" && hasValue)
+				settings.filter = args[++i];
+			else if (argument == "--time" && hasValue)
+				settings.minRepetitionMilliseconds = std::max(std::atof(args[++i]), 1.0);
+			else if (argument == "--repetitions" && hasValue)
+				settings.repetitionCount = std::max(std::atoi(args[++i]), 1);
+			else
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* args[])
+{
+	MicroBenchmarkSettings settings{};
+	if (!ParseArguments(argc, args, settings))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<Kernel> kernels{};
+	const auto addKernel = [&](Kernel&& kernel)
+		{
+			if (kernel.name.find(settings.filter) != std::string::npos)
+				kernels.push_back(std::move(kernel));
+		};
+
+	//The sets have to outlive the kernels, which only keep references to them
+	std::vector<std::vector<TestCase<Sphere>>> sphereSets{};
+	std::vector<std::vector<TestCase<Plane>>> planeSets{};
+	std::vector<std::vector<TestCase<PrecomputedTriangle>>> triangleSets{};
+	std::vector<std::vector<TestCase<TriangleBlockPrimitive>>> triangleBlockSets{};
+	std::vector<std::vector<TestCase<BoxPrimitive>>> boxSets{};
+	for (const uint32_t hitPercentage : HIT_PERCENTAGES)
+	{
+		sphereSets.push_back(CreateSphereSet(hitPercentage));
+		planeSets.push_back(CreatePlaneSet(hitPercentage));
+		triangleSets.push_back(CreateTriangleSet(hitPercentage));
+		triangleBlockSets.push_back(CreateTriangleBlockSet(hitPercentage));
+		boxSets.push_back(CreateBoxSet(hitPercentage));
+	}
+	const std::vector<BRDFCase> brdfSet{ CreateBRDFSet() };
+
+	for (size_t setIndex{}; setIndex < std::size(HIT_PERCENTAGES); ++setIndex)
+	{
+		const uint32_t hitPercentage{ HIT_PERCENTAGES[setIndex] };
+
+#pragma region Spheres and Planes
+		addKernel(CreateRayKernel("HitTest_Sphere", "Scalar", hitPercentage, 1, sphereSets[setIndex],
+			[](const TestCase<Sphere>& testCase, uint32_t lane)
+			{
+				HitRecord hitRecord{};
+				return GeometryUtils::HitTest_Sphere(testCase.primitive, testCase.rays[lane], hitRecord);
+			}));
+		addKernel(CreatePacketKernel("HitTest_Sphere", hitPercentage, sphereSets[setIndex],
+			[](const TestCase<Sphere>& testCase)
+			{
+				HitRecord hitRecords[RAY_PACKET_SIZE]{};
+				return GeometryUtils::HitTest_Sphere(testCase.primitive, testCase.packet, testCase.packet.activeMask, hitRecords);
+			}));
+		addKernel(CreateRayKernel("HitTest_Sphere (occlusion)", "Scalar", hitPercentage, 1, sphereSets[setIndex],
+			[](const TestCase<Sphere>& testCase, uint32_t lane) { return GeometryUtils::HitTest_Sphere(testCase.primitive, testCase.rays[lane]); }));
+		addKernel(CreatePacketKernel("HitTest_Sphere (occlusion)", hitPercentage, sphereSets[setIndex],
+			[](const TestCase<Sphere>& testCase) { return GeometryUtils::HitTest_Sphere(testCase.primitive, testCase.packet, testCase.packet.activeMask); }));
+
+		addKernel(CreateRayKernel("HitTest_Plane", "Scalar", hitPercentage, 1, planeSets[setIndex],
+			[](const TestCase<Plane>& testCase, uint32_t lane)
+			{
+				HitRecord hitRecord{};
+				return GeometryUtils::HitTest_Plane(testCase.primitive, testCase.rays[lane], hitRecord);
+			}));
+		addKernel(CreatePacketKernel("HitTest_Plane", hitPercentage, planeSets[setIndex],
+			[](const TestCase<Plane>& testCase)
+			{
+				HitRecord hitRecords[RAY_PACKET_SIZE]{};
+				return GeometryUtils::HitTest_Plane(testCase.primitive, testCase.packet, testCase.packet.activeMask, hitRecords);
+			}));
+		addKernel(CreateRayKernel("HitTest_Plane (occlusion)", "Scalar", hitPercentage, 1, planeSets[setIndex],
+			[](const TestCase<Plane>& testCase, uint32_t lane) { return GeometryUtils::HitTest_Plane(testCase.primitive, testCase.rays[lane]); }));
+		addKernel(CreatePacketKernel("HitTest_Plane (occlusion)", hitPercentage, planeSets[setIndex],
+			[](const TestCase<Plane>& testCase) { return GeometryUtils::HitTest_Plane(testCase.primitive, testCase.packet, testCase.packet.activeMask); }));
+#pragma endregion
+
+#pragma region Triangles
+		addKernel(CreateRayKernel("HitTest_Triangle", "Scalar", hitPercentage, 1, triangleSets[setIndex],
+			[](const TestCase<PrecomputedTriangle>& testCase, uint32_t lane)
+			{
+				HitRecord hitRecord{};
+				return GeometryUtils::HitTest_Triangle(testCase.primitive, TriangleCullMode::NoCulling, testCase.rays[lane], hitRecord);
+			}));
+		addKernel(CreateRayKernel("DoesHit_Triangle", "Scalar", hitPercentage, 1, triangleSets[setIndex],
+			[](const TestCase<PrecomputedTriangle>& testCase, uint32_t lane)
+			{
+				return GeometryUtils::DoesHit_Triangle(testCase.primitive, TriangleCullMode::NoCulling, testCase.rays[lane]);
+			}));
+
+		//Block kernels are timed per triangle so they line up with the single triangle tests, the hit ratio is per ray
+		for (const TriangleKernel triangleKernel : { TriangleKernel::Scalar, TriangleKernel::SSE4, TriangleKernel::AVX2 })
+		{
+			const std::string variant{ GeometryUtils::GetTriangleKernelName(triangleKernel) };
+			Kernel hitTestKernel{ CreateRayKernel("HitTest_TriangleBlock", variant, hitPercentage, TRIANGLE_BLOCK_WIDTH, triangleBlockSets[setIndex],
+				[](const TestCase<TriangleBlockPrimitive>& testCase, uint32_t lane)
+				{
+					HitRecord hitRecord{};
+					return GeometryUtils::HitTest_TriangleBlock(testCase.primitive.block, TRIANGLE_BLOCK_WIDTH, TriangleCullMode::NoCulling, testCase.rays[lane], hitRecord);
+				}) };
+			hitTestKernel.triangleKernel = triangleKernel;
+			addKernel(std::move(hitTestKernel));
+
+			Kernel doesHitKernel{ CreateRayKernel("DoesHit_TriangleBlock", variant, hitPercentage, TRIANGLE_BLOCK_WIDTH, triangleBlockSets[setIndex],
+				[](const TestCase<TriangleBlockPrimitive>& testCase, uint32_t lane)
+				{
+					return GeometryUtils::DoesHit_TriangleBlock(testCase.primitive.block, TRIANGLE_BLOCK_WIDTH, TriangleCullMode::NoCulling, testCase.rays[lane]);
+				}) };
+			doesHitKernel.triangleKernel = triangleKernel;
+			addKernel(std::move(doesHitKernel));
+		}
+#pragma endregion
+
+#pragma region Bounding Boxes
+		addKernel(CreateRayKernel("SlabTest_TriangleMesh", "Scalar", hitPercentage, 1, boxSets[setIndex],
+			[](const TestCase<BoxPrimitive>& testCase, uint32_t lane) { return GeometryUtils::SlabTest_TriangleMesh(testCase.primitive.instance, testCase.rays[lane]); }));
+		addKernel(CreateRayKernel("SlabTest_BVHNode", "Scalar", hitPercentage, 1, boxSets[setIndex],
+			[](const TestCase<BoxPrimitive>& testCase, uint32_t lane)
+			{
+				return GeometryUtils::SlabTest_BVHNode(testCase.primitive.node, testCase.rays[lane], testCase.invDirections[lane]) < FLT_MAX;
+			}));
+		addKernel(CreatePacketKernel("SlabTest_BVHNode", hitPercentage, boxSets[setIndex],
+			[](const TestCase<BoxPrimitive>& testCase)
+			{
+				return GeometryUtils::SlabTest_BVHNode(testCase.primitive.node, testCase.packet, testCase.packetInvDirection, testCase.packet.activeMask);
+			}));
+#pragma endregion
+	}
+
+#pragma region BRDFs
+	addKernel(CreateBRDFKernel("BRDF::Lambert", brdfSet, [](const BRDFCase& brdfCase) { return Sum(BRDF::Lambert(0.8f, brdfCase.f0)); }));
+	addKernel(CreateBRDFKernel("BRDF::Phong", brdfSet, [](const BRDFCase& brdfCase) { return Sum(BRDF::Phong(0.5f, 60.f, brdfCase.l, brdfCase.v, brdfCase.n)); }));
+	addKernel(CreateBRDFKernel("BRDF::FresnelFunction_Schlick", brdfSet, [](const BRDFCase& brdfCase) { return Sum(BRDF::FresnelFunction_Schlick(brdfCase.h, brdfCase.v, brdfCase.f0)); }));
+	addKernel(CreateBRDFKernel("BRDF::NormalDistribution_GGX", brdfSet, [](const BRDFCase& brdfCase) { return BRDF::NormalDistribution_GGX(brdfCase.n, brdfCase.h, brdfCase.roughness); }));
+	addKernel(CreateBRDFKernel("BRDF::GeometryFunction_Smith", brdfSet, [](const BRDFCase& brdfCase) { return BRDF::GeometryFunction_Smith(brdfCase.n, brdfCase.v, brdfCase.l, brdfCase.roughness); }));
+#pragma endregion
+
+	if (kernels.empty())
+	{
+		std::cout << "No kernel matches \"" << settings.filter << "\"\n";
+		return 1;
+	}
+
+	//The statistics counters in the intersection tests stay enabled, they are part of what the renderer pays per test
+	const TriangleKernel defaultTriangleKernel{ GeometryUtils::GetTriangleKernel() };
+	std::cout << PRIMITIVE_COUNT << " primitives x " << RAY_PACKET_SIZE << " rays per set, best of " << settings.repetitionCount << " repetitions of at least "
+		<< settings.minRepetitionMilliseconds << " ms\n"
+		<< "Widest supported triangle kernel: " << GeometryUtils::GetTriangleKernelName(defaultTriangleKernel) << "\n\n";
+	std::cout << std::left << std::setw(34) << "Kernel" << std::setw(8) << "Variant" << std::right << std::setw(6) << "Hits"
+		<< std::setw(12) << "ns/test" << std::setw(14) << "M tests/s" << std::setw(13) << "Measured" << "\n";
+	std::cout << std::fixed << std::setprecision(2);
+
+	for (const Kernel& kernel : kernels)
+	{
+		//Kernels the CPU doesn't support are skipped instead of silently running the fallback
+		const TriangleKernel triangleKernel{ kernel.triangleKernel.value_or(defaultTriangleKernel) };
+		if (!GeometryUtils::SetTriangleKernel(triangleKernel))
+			continue;
+
+		Measure(kernel, settings);
+	}
+
+	GeometryUtils::SetTriangleKernel(defaultTriangleKernel);
+	return 0;
+}
@@ -0,0 +1,458 @@
+#include "OBJParser.h"
+
+//Standard includes
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <memory>
+#include <thread>
+
+//Project includes
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Files are only split when every chunk gets at least this much text, smaller files are parsed on the calling thread
+		constexpr size_t MIN_CHUNK_SIZE{ 1 << 20 };
+		//Chunks per thread, extra chunks let work stealing even out chunks that parse slower
+		constexpr uint32_t CHUNKS_PER_THREAD{ 4 };
+
+		//Every power of ten that is exactly representable as a double
+		constexpr double POWERS_OF_TEN[]{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		constexpr int MAX_EXACT_EXPONENT{ 22 };
+		constexpr int MAX_MANTISSA_DIGITS{ 19 };
+		constexpr uint64_t MAX_EXACT_MANTISSA{ uint64_t{ 1 } << 53 };
+
+		struct FaceCorner
+		{
+			int position{};
+			int texcoord{};
+			int normal{};
+		};
+
+		//Everything one chunk parsed, indices are 0 based but only absolute where the file used positive indices
+		struct ChunkData
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> texcoords{};
+			std::vector<Vector3> normals{};
+
+			std::vector<int> positionIndices{};
+			std::vector<int> texcoordIndices{};
+			std::vector<int> normalIndices{};
+
+			//Entries of the index arrays written from a negative index, they are relative to the first vertex of the chunk
+			//until the merge adds the number of vertices in all earlier chunks
+			std::vector<uint32_t> relativePositionIndices{};
+			std::vector<uint32_t> relativeTexcoordIndices{};
+			std::vector<uint32_t> relativeNormalIndices{};
+
+			std::vector<FaceCorner> faceCorners{};
+			bool isValid{ true };
+		};
+
+		bool IsDigit(char character)
+		{
+			return static_cast<unsigned char>(character - '0') < 10;
+		}
+
+		bool IsLineEnd(char character)
+		{
+			return character == '\n' || character == '\r';
+		}
+
+		void SkipBlanks(const char*& pText, const char* pEnd)
+		{
+			while (pText < pEnd && (*pText == ' ' || *pText == '\t'))
+				++pText;
+		}
+
+		void SkipLine(const char*& pText, const char* pEnd)
+		{
+			while (pText < pEnd && *pText != '\n')
+				++pText;
+			if (pText < pEnd)
+				++pText;
+		}
+
+		bool ScanInt(const char*& pText, const char* pEnd, int& value)
+		{
+			SkipBlanks(pText, pEnd);
+
+			const bool isNegative{ pText < pEnd && *pText == '-' };
+			if (pText < pEnd && (*pText == '-' || *pText == '+'))
+				++pText;
+
+			if (pText == pEnd || !IsDigit(*pText))
+				return false;
+
+			int64_t magnitude{};
+			for (; pText < pEnd && IsDigit(*pText); ++pText)
+				magnitude = std::min<int64_t>(magnitude * 10 + (*pText - '0'), INT32_MAX);
+
+			value = static_cast<int>(isNegative ? -magnitude : magnitude);
+			return true;
+		}
+
+		//Decimal scanner for the plain numbers OBJ exporters write, mantissas below 2^53 with small exponents take one correctly
+		//rounded double operation that is then rounded to float. That second rounding can land one ulp away from std::from_chars<float>
+		//for values right between two floats, far below what mesh positions care about. Anything longer or larger goes through std::from_chars
+		bool ScanFloat(const char*& pText, const char* pEnd, float& value)
+		{
+			SkipBlanks(pText, pEnd);
+			const char* pStart{ pText };
+
+			const bool isNegative{ pText < pEnd && *pText == '-' };
+			if (pText < pEnd && (*pText == '-' || *pText == '+'))
+				++pText;
+			const char* pNumber{ pText };
+
+			uint64_t mantissa{};
+			int digitCount{};
+			int exponent{};
+			bool isTruncated{};
+			bool hasDigits{};
+
+			for (; pText < pEnd && IsDigit(*pText); ++pText)
+			{
+				hasDigits = true;
+				if (digitCount < MAX_MANTISSA_DIGITS)
+				{
+					mantissa = mantissa * 10 + (*pText - '0');
+					//Leading zeros don't use up precision
+					digitCount += mantissa != 0 ? 1 : 0;
+				}
+				else
+				{
+					++exponent;
+					isTruncated = true;
+				}
+			}
+
+			if (pText < pEnd && *pText == '.')
+			{
+				for (++pText; pText < pEnd && IsDigit(*pText); ++pText)
+				{
+					hasDigits = true;
+					if (digitCount < MAX_MANTISSA_DIGITS)
+					{
+						mantissa = mantissa * 10 + (*pText - '0');
+						digitCount += mantissa != 0 ? 1 : 0;
+						--exponent;
+					}
+					else
+						isTruncated = true;
+				}
+			}
+
+			if (!hasDigits)
+			{
+				pText = pStart;
+				return false;
+			}
+
+			if (pText < pEnd && (*pText == 'e' || *pText == 'E'))
+			{
+				const char* pExponent{ pText + 1 };
+				int exponentValue{};
+				if (pExponent < pEnd && (IsDigit(*pExponent) || *pExponent == '-' || *pExponent == '+') && ScanInt(pExponent, pEnd, exponentValue))
+				{
+					exponent += std::clamp(exponentValue, -10000, 10000);
+					pText = pExponent;
+				}
+			}
+
+			if (isTruncated || mantissa >= MAX_EXACT_MANTISSA || exponent < -MAX_EXACT_EXPONENT || exponent > MAX_EXACT_EXPONENT)
+			{
+				//std::from_chars doesn't take a leading plus
+				const std::from_chars_result result{ std::from_chars(isNegative ? pStart : pNumber, pEnd, value) };
+				if (result.ec != std::errc{} && result.ec != std::errc::result_out_of_range)
+				{
+					pText = pStart;
+					return false;
+				}
+				pText = result.ptr;
+				return true;
+			}
+
+			const double magnitude{ exponent < 0 ? mantissa / POWERS_OF_TEN[-exponent] : mantissa * POWERS_OF_TEN[exponent] };
+			value = static_cast<float>(isNegative ? -magnitude : magnitude);
+			return true;
+		}
+
+		//OBJ attribute lines have up to 3 numbers, missing trailing components stay 0
+		Vector3 ScanVector(const char*& pText, const char* pEnd)
+		{
+			Vector3 vector{};
+			if (ScanFloat(pText, pEnd, vector.x) && ScanFloat(pText, pEnd, vector.y))
+				ScanFloat(pText, pEnd, vector.z);
+			return vector;
+		}
+
+		//Turns a 1 based or negative OBJ index into a 0 based one, negative ones are remembered for the merge
+		int ResolveIndex(int objIndex, size_t chunkVertexCount, std::vector<uint32_t>& relativeEntries, size_t entryIndex, bool& isValid)
+		{
+			if (objIndex > 0)
+				return objIndex - 1;
+
+			if (objIndex == 0)
+				isValid = false;
+
+			relativeEntries.push_back(static_cast<uint32_t>(entryIndex));
+			return static_cast<int>(chunkVertexCount) + objIndex;
+		}
+
+		void AddCorner(ChunkData& chunk, const FaceCorner& corner)
+		{
+			const size_t entryIndex{ chunk.positionIndices.size() };
+			chunk.positionIndices.push_back(ResolveIndex(corner.position, chunk.positions.size(), chunk.relativePositionIndices, entryIndex, chunk.isValid));
+
+			//Corners without an attribute get -1, the arrays are only started once the chunk finds the first one
+			if (corner.texcoord != 0)
+			{
+				chunk.texcoordIndices.resize(entryIndex, -1);
+				chunk.texcoordIndices.push_back(ResolveIndex(corner.texcoord, chunk.texcoords.size(), chunk.relativeTexcoordIndices, entryIndex, chunk.isValid));
+			}
+			if (corner.normal != 0)
+			{
+				chunk.normalIndices.resize(entryIndex, -1);
+				chunk.normalIndices.push_back(ResolveIndex(corner.normal, chunk.normals.size(), chunk.relativeNormalIndices, entryIndex, chunk.isValid));
+			}
+		}
+
+		//Corners in the v, v/vt, v//vn or v/vt/vn form, polygons are triangulated as a fan around the first corner
+		void ParseFace(const char*& pText, const char* pEnd, ChunkData& chunk)
+		{
+			std::vector<FaceCorner>& corners{ chunk.faceCorners };
+			corners.clear();
+
+			while (true)
+			{
+				SkipBlanks(pText, pEnd);
+				if (pText == pEnd || IsLineEnd(*pText) || *pText == '#')
+					break;
+
+				FaceCorner corner{};
+				if (!ScanInt(pText, pEnd, corner.position))
+				{
+					chunk.isValid = false;
+					return;
+				}
+
+				if (pText < pEnd && *pText == '/')
+				{
+					++pText;
+					if (pText < pEnd && *pText != '/' && !ScanInt(pText, pEnd, corner.texcoord))
+					{
+						chunk.isValid = false;
+						return;
+					}
+					if (pText < pEnd && *pText == '/')
+					{
+						++pText;
+						if (!ScanInt(pText, pEnd, corner.normal))
+						{
+							chunk.isValid = false;
+							return;
+						}
+					}
+				}
+
+				corners.push_back(corner);
+			}
+
+			for (size_t i{ 1 }; i + 1 < corners.size(); ++i)
+			{
+				AddCorner(chunk, corners[0]);
+				AddCorner(chunk, corners[i]);
+				AddCorner(chunk, corners[i + 1]);
+			}
+		}
+
+		void ParseChunk(ChunkData& chunk)
+		{
+			TRACE_ZONE("OBJParser::ParseChunk");
+
+			const char* pText{ chunk.pBegin };
+			const char* pEnd{ chunk.pEnd };
+			while (pText < pEnd)
+			{
+				SkipBlanks(pText, pEnd);
+				if (pText + 1 < pEnd && pText[0] == 'v')
+				{
+					if (pText[1] == ' ' || pText[1] == '\t')
+					{
+						pText += 1;
+						chunk.positions.push_back(ScanVector(pText, pEnd));
+					}
+					else if (pText[1] == 't' && pText + 2 < pEnd && (pText[2] == ' ' || pText[2] == '\t'))
+					{
+						pText += 2;
+						chunk.texcoords.push_back(ScanVector(pText, pEnd));
+					}
+					else if (pText[1] == 'n' && pText + 2 < pEnd && (pText[2] == ' ' || pText[2] == '\t'))
+					{
+						pText += 2;
+						chunk.normals.push_back(ScanVector(pText, pEnd));
+					}
+				}
+				else if (pText + 1 < pEnd && pText[0] == 'f' && (pText[1] == ' ' || pText[1] == '\t'))
+				{
+					pText += 1;
+					ParseFace(pText, pEnd, chunk);
+				}
+
+				//Whatever is left of the line, including w components, vertex colors and comments
+				SkipLine(pText, pEnd);
+			}
+
+			if (!chunk.texcoordIndices.empty())
+				chunk.texcoordIndices.resize(chunk.positionIndices.size(), -1);
+			if (!chunk.normalIndices.empty())
+				chunk.normalIndices.resize(chunk.positionIndices.size(), -1);
+		}
+
+		/**
+		 * \brief Copies the indices of a chunk to their place in the merged array, makes relative indices absolute and checks the range
+		 * \param minIndex -1 for the optional attributes, where it marks a corner without one
+		 * \return false when an index points outside the merged vertex array
+		 */
+		bool MergeIndices(const std::vector<int>& chunkIndices, const std::vector<uint32_t>& relativeEntries, size_t entryCount,
+			int* pMergedIndices, int vertexBase, int vertexCount, int minIndex)
+		{
+			if (chunkIndices.empty())
+			{
+				std::fill_n(pMergedIndices, entryCount, -1);
+				return true;
+			}
+
+			std::copy(chunkIndices.begin(), chunkIndices.end(), pMergedIndices);
+			for (const uint32_t entry : relativeEntries)
+			{
+				pMergedIndices[entry] += vertexBase;
+				//A relative index reaching in front of the first vertex
+				if (pMergedIndices[entry] < 0)
+					return false;
+			}
+
+			return std::all_of(pMergedIndices, pMergedIndices + entryCount, [&](int index) { return index >= minIndex && index < vertexCount; });
+		}
+	}
+
+	bool OBJParser::Parse(const std::string& path, OBJData& data, uint32_t threadCount)
+	{
+		MappedFile file{};
+		if (!file.Open(path))
+			return false;
+
+		return Parse(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), data, threadCount);
+	}
+
+	bool OBJParser::Parse(const char* pText, size_t size, OBJData& data, uint32_t threadCount)
+	{
+		TRACE_ZONE("OBJParser::Parse");
+
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		//Chunks start right after a line break, so no line is ever split
+		const size_t chunkCount{ std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, threadCount * CHUNKS_PER_THREAD) };
+		std::vector<ChunkData> chunks(chunkCount);
+		const char* pEnd{ pText + size };
+		for (size_t chunkIndex{}; chunkIndex < chunkCount; ++chunkIndex)
+		{
+			const char* pBegin{ chunkIndex == 0 ? pText : pText + size * chunkIndex / chunkCount };
+			if (chunkIndex > 0)
+			{
+				pBegin = std::max(pBegin, chunks[chunkIndex - 1].pBegin);
+				while (pBegin < pEnd && pBegin[-1] != '\n')
+					++pBegin;
+				chunks[chunkIndex - 1].pEnd = pBegin;
+			}
+			chunks[chunkIndex].pBegin = pBegin;
+		}
+		chunks.back().pEnd = pEnd;
+
+		//Small files don't pay for starting threads
+		std::unique_ptr<ThreadPool> pThreadPool{ chunkCount > 1 ? std::make_unique<ThreadPool>(threadCount) : nullptr };
+		const auto runTasks = [&](uint32_t taskCount, const std::function<void(uint32_t)>& task)
+			{
+				if (pThreadPool)
+					pThreadPool->ParallelFor(taskCount, task);
+				else
+					for (uint32_t taskIndex{}; taskIndex < taskCount; ++taskIndex)
+						task(taskIndex);
+			};
+
+		runTasks(static_cast<uint32_t>(chunkCount), [&](uint32_t chunkIndex) { ParseChunk(chunks[chunkIndex]); });
+
+		if (std::any_of(chunks.begin(), chunks.end(), [](const ChunkData& chunk) { return !chunk.isValid; }))
+			return false;
+
+		TRACE_ZONE("OBJParser::Merge");
+
+		//Where every chunk goes in the merged arrays
+		struct ChunkOffsets
+		{
+			size_t position{};
+			size_t texcoord{};
+			size_t normal{};
+			size_t index{};
+		};
+		std::vector<ChunkOffsets> offsets(chunkCount + 1);
+		bool hasTexcoordIndices{};
+		bool hasNormalIndices{};
+		for (size_t chunkIndex{}; chunkIndex < chunkCount; ++chunkIndex)
+		{
+			const ChunkData& chunk{ chunks[chunkIndex] };
+			offsets[chunkIndex + 1].position = offsets[chunkIndex].position + chunk.positions.size();
+			offsets[chunkIndex + 1].texcoord = offsets[chunkIndex].texcoord + chunk.texcoords.size();
+			offsets[chunkIndex + 1].normal = offsets[chunkIndex].normal + chunk.normals.size();
+			offsets[chunkIndex + 1].index = offsets[chunkIndex].index + chunk.positionIndices.size();
+			hasTexcoordIndices |= !chunk.texcoordIndices.empty();
+			hasNormalIndices |= !chunk.normalIndices.empty();
+		}
+
+		const ChunkOffsets& totals{ offsets.back() };
+		data.positions.resize(totals.position);
+		data.texcoords.resize(totals.texcoord);
+		data.normals.resize(totals.normal);
+		data.positionIndices.resize(totals.index);
+		data.texcoordIndices.resize(hasTexcoordIndices ? totals.index : 0);
+		data.normalIndices.resize(hasNormalIndices ? totals.index : 0);
+
+		std::atomic<bool> isValid{ true };
+		runTasks(static_cast<uint32_t>(chunkCount), [&](uint32_t chunkIndex)
+			{
+				const ChunkData& chunk{ chunks[chunkIndex] };
+				const ChunkOffsets& chunkOffsets{ offsets[chunkIndex] };
+				const size_t entryCount{ chunk.positionIndices.size() };
+
+				std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + chunkOffsets.position);
+				std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), data.texcoords.begin() + chunkOffsets.texcoord);
+				std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + chunkOffsets.normal);
+
+				bool isChunkValid{ MergeIndices(chunk.positionIndices, chunk.relativePositionIndices, entryCount, data.positionIndices.data() + chunkOffsets.index,
+					static_cast<int>(chunkOffsets.position), static_cast<int>(totals.position), 0) };
+				if (hasTexcoordIndices)
+					isChunkValid &= MergeIndices(chunk.texcoordIndices, chunk.relativeTexcoordIndices, entryCount, data.texcoordIndices.data() + chunkOffsets.index,
+						static_cast<int>(chunkOffsets.texcoord), static_cast<int>(totals.texcoord), -1);
+				if (hasNormalIndices)
+					isChunkValid &= MergeIndices(chunk.normalIndices, chunk.relativeNormalIndices, entryCount, data.normalIndices.data() + chunkOffsets.index,
+						static_cast<int>(chunkOffsets.normal), static_cast<int>(totals.normal), -1);
+
+				if (!isChunkValid)
+					isValid.store(false, std::memory_order_relaxed);
+			});
+
+		return isValid.load();
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Vector3.h"
+
+namespace dae
+{
+	//Contents of an OBJ file, faces are triangulated as fans and every index is 0 based
+	struct OBJData
+	{
+		std::vector<Vector3> positions{};
+		//vt entries as u, v, w, missing components are 0
+		std::vector<Vector3> texcoords{};
+		//vn entries as written, they are not normalized
+		std::vector<Vector3> normals{};
+
+		//3 per triangle
+		std::vector<int> positionIndices{};
+		//Either empty when no face references a texcoord/normal, or 3 per triangle with -1 for corners without one
+		std::vector<int> texcoordIndices{};
+		std::vector<int> normalIndices{};
+	};
+
+	//Multithreaded OBJ parser: the file is split into chunks on line boundaries that are parsed in parallel and merged.
+	//Supports v, vt, vn and faces in the v, v/vt, v//vn and v/vt/vn forms with negative (relative) indices, other lines are skipped
+	namespace OBJParser
+	{
+		/**
+		 * \brief Memory maps and parses an OBJ file
+		 * \param threadCount threads used for large files, 0 uses every hardware thread
+		 * \return false when the file can't be read or a face references a vertex that doesn't exist
+		 */
+		bool Parse(const std::string& path, OBJData& data, uint32_t threadCount = 0);
+
+		//Parses OBJ text that is already in memory, e.g. a mapped file
+		bool Parse(const char* pText, size_t size, OBJData& data, uint32_t threadCount = 0);
+	}
+}
@@ -0,0 +1,84 @@
+#include "RenderStatistics.h"
+
+//Standard includes
+#include <iomanip>
+#include <sstream>
+
+namespace dae
+{
+	namespace
+	{
+		double PerRay(uint64_t count, uint64_t rayCount)
+		{
+			return rayCount > 0 ? static_cast<double>(count) / rayCount : 0.0;
+		}
+
+		double PerSecond(uint64_t count, float seconds)
+		{
+			return seconds > 0.f ? count / static_cast<double>(seconds) : 0.0;
+		}
+	}
+
+	std::string Statistics::ToText(const RenderStatistics& statistics, float seconds)
+	{
+		const uint64_t rayCount{ statistics.primaryRays + statistics.shadowRays };
+
+		std::ostringstream stream{};
+		stream << std::fixed << std::setprecision(2)
+			<< PerSecond(statistics.primaryRays, seconds) / 1e6 << " M primary rays/s, "
+			<< PerSecond(statistics.shadowRays, seconds) / 1e6 << " M shadow rays/s ("
+			<< PerRay(statistics.occludedShadowRays, statistics.shadowRays) * 100.0 << "% occluded), per ray: "
+			<< PerRay(statistics.nodeVisits, rayCount) << " nodes, "
+			<< PerRay(statistics.triangleTests, rayCount) << " triangles, "
+			<< PerRay(statistics.sphereTests, rayCount) << " spheres, "
+			<< PerRay(statistics.planeTests, rayCount) << " planes, "
+			<< PerRay(statistics.shadeCalls, statistics.primaryRays) << " shade calls per primary ray, "
+			<< PerRay(statistics.reprojectedPixels, statistics.reprojectedPixels + statistics.primaryRays) * 100.0 << "% of the pixels reprojected";
+		return stream.str();
+	}
+
+	std::string Statistics::ToJSON(const RenderStatistics& statistics, float seconds)
+	{
+		std::ostringstream stream{};
+		stream << std::fixed << std::setprecision(4) << "{\"seconds\":" << seconds
+			<< std::setprecision(1)
+			<< ",\"primary_rays_per_second\":" << PerSecond(statistics.primaryRays, seconds)
+			<< ",\"shadow_rays_per_second\":" << PerSecond(statistics.shadowRays, seconds)
+			<< ",\"occluded_shadow_rays_per_second\":" << PerSecond(statistics.occludedShadowRays, seconds)
+			<< ",\"sphere_tests_per_second\":" << PerSecond(statistics.sphereTests, seconds)
+			<< ",\"plane_tests_per_second\":" << PerSecond(statistics.planeTests, seconds)
+			<< ",\"triangle_tests_per_second\":" << PerSecond(statistics.triangleTests, seconds)
+			<< ",\"node_visits_per_second\":" << PerSecond(statistics.nodeVisits, seconds)
+			<< ",\"shade_calls_per_second\":" << PerSecond(statistics.shadeCalls, seconds)
+			<< ",\"reprojected_pixels_per_second\":" << PerSecond(statistics.reprojectedPixels, seconds)
+			<< "}";
+		return stream.str();
+	}
+
+	std::string Statistics::ToText(const SampleDistribution& distribution)
+	{
+		std::ostringstream stream{};
+		stream << std::fixed << std::setprecision(2)
+			<< PerRay(distribution.sampleCount, distribution.pixelCount) << " samples per pixel ("
+			<< distribution.minSamplesPerPixel << " - " << distribution.maxSamplesPerPixel << "), uniform sampling needs "
+			<< distribution.uniformSamplesPerPixel << " for the same mean variance of " << std::scientific << distribution.meanError
+			<< std::fixed << "\n";
+
+		//Percentage of the pixels per power of two range of sample counts
+		for (uint32_t bucket{}; bucket < SAMPLE_HISTOGRAM_BUCKETS; ++bucket)
+		{
+			if (distribution.histogram[bucket] == 0)
+				continue;
+
+			const uint32_t firstCount{ 1u << bucket };
+			std::string range{ std::to_string(firstCount) };
+			if (bucket + 1 == SAMPLE_HISTOGRAM_BUCKETS)
+				range += "+";
+			else if (bucket > 0)
+				range += " - " + std::to_string((firstCount << 1) - 1);
+
+			stream << std::setw(13) << range << ": " << std::setw(6) << PerRay(distribution.histogram[bucket], distribution.pixelCount) * 100.0 << "% of the pixels\n";
+		}
+		return stream.str();
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Work done while rendering, tests and node visits are counted per ray, so a packet test of 16 lanes counts 16
+	struct RenderStatistics
+	{
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+		uint64_t occludedShadowRays{};
+
+		uint64_t sphereTests{};
+		uint64_t planeTests{};
+		uint64_t triangleTests{};
+		//AABB tests of scene and mesh BVH nodes
+		uint64_t nodeVisits{};
+		uint64_t shadeCalls{};
+		//Pixels taken from the last frame instead of being traced
+		uint64_t reprojectedPixels{};
+
+		RenderStatistics& operator+=(const RenderStatistics& other)
+		{
+			primaryRays += other.primaryRays;
+			shadowRays += other.shadowRays;
+			occludedShadowRays += other.occludedShadowRays;
+			sphereTests += other.sphereTests;
+			planeTests += other.planeTests;
+			triangleTests += other.triangleTests;
+			nodeVisits += other.nodeVisits;
+			shadeCalls += other.shadeCalls;
+			reprojectedPixels += other.reprojectedPixels;
+			return *this;
+		}
+	};
+
+	//Buckets of SampleDistribution::histogram, bucket i counts the pixels with [2^i, 2^(i+1)) samples and the last one everything above
+	constexpr uint32_t SAMPLE_HISTOGRAM_BUCKETS{ 16 };
+
+	//Samples per pixel of a progressive accumulation, to compare adaptive against uniform sampling
+	struct SampleDistribution
+	{
+		uint64_t pixelCount{};
+		uint64_t sampleCount{};
+		uint32_t minSamplesPerPixel{};
+		uint32_t maxSamplesPerPixel{};
+		uint64_t histogram[SAMPLE_HISTOGRAM_BUCKETS]{};
+
+		//Mean over all pixels of the variance of their mean luminance
+		double meanError{};
+		//Samples per pixel uniform sampling needs for the same mean error, given the per pixel variances measured so far
+		double uniformSamplesPerPixel{};
+	};
+
+	namespace Statistics
+	{
+		//Counters of the calling thread, the intersection tests add to them without any synchronization.
+		//The renderer clears them before a tile and moves them into the totals of that tile afterwards
+		inline RenderStatistics& GetThreadStatistics()
+		{
+			thread_local RenderStatistics threadStatistics{};
+			return threadStatistics;
+		}
+
+		//One line summary with rays per second and tests per ray, seconds is the time the statistics were gathered over
+		std::string ToText(const RenderStatistics& statistics, float seconds);
+		//Same values as one line of JSON, counts are per second
+		std::string ToJSON(const RenderStatistics& statistics, float seconds);
+		//Average and range of the samples per pixel, the histogram and the uniform sample count for the same error
+		std::string ToText(const SampleDistribution& distribution);
+	}
+}
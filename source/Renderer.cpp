@@ -1,107 +1,658 @@
-//External includes
-#include "SDL.h"
-#include "SDL_surface.h"
-
 //Project includes
 #include "Renderer.h"
+#include "FrameBuffer.h"
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
 
-#include <future> //async
-#include<ppl.h> //parallel_for
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <numeric>
 
 using namespace dae;
 
-//#define ASYNC
-#define PARALLEL_FOR
+namespace
+{
+	//A tile never counts as converged on fewer samples, a few samples that all land on the same side of an edge look converged too
+	constexpr uint32_t PROGRESSIVE_MIN_SAMPLE_COUNT{ 8 };
+	//Cap on the samples one tile gets in a frame, a single tile keeps one worker busy and shouldn't hold up the frame
+	constexpr uint32_t PROGRESSIVE_MAX_TILE_SAMPLES_PER_FRAME{ 8 };
+
+	//Dynamic resolution never traces less than this fraction of the width and height, and changes it in steps of this size
+	constexpr float MIN_RENDER_SCALE{ 0.25f };
+	constexpr float RENDER_SCALE_STEP{ 1.f / 32.f };
+	//Frames the average needs after a change before it says anything about the new resolution
+	constexpr uint32_t RENDER_SCALE_SETTLE_FRAMES{ 4 };
+
+	//While reprojecting, a rotating one in this many pixels is traced every frame even when it could be reprojected
+	constexpr uint32_t REPROJECTION_REFRESH_INTERVAL{ 8 };
+	//Relative depth difference to a neighbour after which a reprojected pixel is traced instead
+	constexpr float REPROJECTION_DEPTH_TOLERANCE{ 0.05f };
+
+	//Position of the primary ray within its pixel for the sample the calling worker traces, tiles of one frame can be at different samples
+	thread_local float g_SampleOffsetX{ 0.5f };
+	thread_local float g_SampleOffsetY{ 0.5f };
+
+	//The first sample goes through the pixel center like a normal frame, the next ones follow the R2 sequence over the pixel
+	void SetSampleOffset(uint32_t sampleIndex)
+	{
+		if (sampleIndex == 0)
+		{
+			g_SampleOffsetX = 0.5f;
+			g_SampleOffsetY = 0.5f;
+			return;
+		}
+
+		const float plasticNumber{ 1.32471795724f };
+		g_SampleOffsetX = std::fmod(0.5f + sampleIndex / plasticNumber, 1.f);
+		g_SampleOffsetY = std::fmod(0.5f + sampleIndex / (plasticNumber * plasticNumber), 1.f);
+	}
+}
 
-Renderer::Renderer(SDL_Window* pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+Renderer::Renderer(FrameBuffer* pFrameBuffer) :
+	m_pFrameBuffer(pFrameBuffer),
+	m_Width(pFrameBuffer->GetWidth()),
+	m_Height(pFrameBuffer->GetHeight()),
+	m_pThreadPool(new ThreadPool())
 {
-	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 }
 
-void Renderer::Render(Scene* pScene) const
+Renderer::~Renderer()
 {
+	delete m_pThreadPool;
+}
+
+void Renderer::Render(Scene* pScene)
+{
+	TRACE_ZONE("Renderer::Render");
+	const auto frameStart{ std::chrono::steady_clock::now() };
+
+	const bool sceneChanged{ pScene->UpdateAccelerationStructure() };
+
 	Camera& camera = pScene->GetCamera();
 	//camera.CalculateCameraToWorld();
 
-	float aspectRatio{ m_Width / static_cast<float>(m_Height) };
+	//The cost heatmap is a measurement, averaging it would hide what one frame costs
+	const bool isProgressive{ m_ProgressiveEnabled && m_CurrentLightingMode != LightingMode::Cost };
+	//A view that stopped changing has no frame time to protect, it gets traced once at the full resolution instead of keeping the scaled down frame
+	const bool isIdle{ !sceneChanged && !camera.isDirty && m_IsFrameValid && m_FrameReuseEnabled };
+	const bool resolutionChanged{ ApplyRenderScale(isProgressive, isIdle) };
+
+	//A reprojected frame keeps stale view dependent shading and resampling errors, it is never reused once the camera stops
+	const bool viewChanged{ sceneChanged || camera.isDirty || !m_IsFrameValid || resolutionChanged || m_IsFrameReprojected };
+	//Only the camera moved since the last frame, anything else changes what the pixels of the last frame should look like
+	const bool canReproject{ m_HasHistory && camera.isDirty && !sceneChanged && m_IsFrameValid && !resolutionChanged };
+	camera.isDirty = false;
+	m_IsFrameValid = true;
+
+	if (viewChanged || !isProgressive)
+		ResetAccumulation(isProgressive);
+
+	//Nothing that ends up in the image changed, the frame buffer still holds this frame or every tile converged
+	if (!viewChanged && (isProgressive ? m_ConvergedTileCount == GetNumTiles() : m_FrameReuseEnabled))
+	{
+		m_FrameStatistics = {};
+		m_pFrameBuffer->Present();
+		return;
+	}
+
+	//Of the frame buffer, a scaled down resolution doesn't keep the exact aspect ratio
+	float aspectRatio{ m_pFrameBuffer->GetWidth() / static_cast<float>(m_pFrameBuffer->GetHeight()) };
 	float fov{ std::tanf((camera.fovAngle * TO_RADIANS) / 2.f) };
 
 	auto& materials = pScene->GetMaterials();
 	auto& lights = pScene->GetLights();
 
-	const uint32_t numPixels = m_Width * m_Height;
+	const bool useReprojection{ m_ReprojectionEnabled && !isProgressive && m_CurrentLightingMode != LightingMode::Cost };
+	if (useReprojection)
+		m_PixelDepths.resize(static_cast<size_t>(m_Width) * m_Height);
+	else if (!m_PixelDepths.empty())
+		m_PixelDepths = {};
+
+	m_IsReprojecting = useReprojection && canReproject;
+	const uint64_t reprojectedPixels{ m_IsReprojecting ? ReprojectFrame(camera, fov, aspectRatio) : 0 };
+
+	//Tiles are small enough for the expensive ones (e.g. covering the bunny) to be spread over many workers by stealing
+	const uint32_t numTiles{ GetNumTiles() };
+	m_TileStatistics.assign(numTiles, {});
+	if (m_CurrentLightingMode == LightingMode::Cost)
+		m_PixelCosts.resize(static_cast<size_t>(m_Width) * m_Height);
+	if (isProgressive)
+		PlanTileSamples();
+
+	m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex)
+		{
+			if (!isProgressive)
+			{
+				SetSampleOffset(0);
+				RenderTile(pScene, tileIndex, fov, aspectRatio, camera, lights, materials, m_TileStatistics[tileIndex]);
+				return;
+			}
+
+			for (uint32_t sample{}; sample < m_TileFrameSampleCounts[tileIndex]; ++sample)
+			{
+				SetSampleOffset(m_TileSampleCounts[tileIndex]);
+				RenderStatistics sampleStatistics{};
+				RenderTile(pScene, tileIndex, fov, aspectRatio, camera, lights, materials, sampleStatistics);
+				m_TileStatistics[tileIndex] += sampleStatistics;
+				AccumulateTile(tileIndex);
+			}
+		});
+
+	if (isProgressive)
+	{
+		m_ConvergedTileCount = static_cast<uint32_t>(std::count(m_TileConverged.begin(), m_TileConverged.end(), uint8_t{ 1 }));
+	}
 
+	m_FrameStatistics = {};
+	for (const RenderStatistics& tileStatistics : m_TileStatistics)
+	{
+		m_FrameStatistics += tileStatistics;
+	}
+	m_FrameStatistics.reprojectedPixels = reprojectedPixels;
+	m_AccumulatedStatistics += m_FrameStatistics;
+
+	m_IsFrameReprojected = m_IsReprojecting;
+	m_IsReprojecting = false;
+	m_HasHistory = useReprojection;
+	if (useReprojection)
+	{
+		m_HistoryCameraToWorld = camera.cameraToWorld;
+		m_HistoryOrigin = camera.origin;
+		m_HistoryFov = fov;
+		m_HistoryAspectRatio = aspectRatio;
+	}
 
-#if defined(ASYNC)
-	const uint32_t numCores = std::thread::hardware_concurrency();
-	std::vector<std::future<void>> async_futures{};
-	const uint32_t numPixelsPerTask = numPixels / numCores;
-	uint32_t numUnassignedPixels = numPixels % numCores;
-	uint32_t currPixelIndex = 0;
+	if (m_CurrentLightingMode == LightingMode::Cost)
+		WriteCostHeatmap();
 
-	for (uint32_t coreId{}; coreId < numCores; ++coreId)
+	//Separate pass over the same tiles, the heatmap replaces the radiance of the whole frame after tracing
 	{
-		uint32_t taskSize = numPixelsPerTask;
-		if (numUnassignedPixels > 0)
+		TRACE_ZONE("FrameBuffer::Resolve");
+		const int outputWidth{ m_pFrameBuffer->GetWidth() };
+		const int outputHeight{ m_pFrameBuffer->GetHeight() };
+		if (m_Width == outputWidth && m_Height == outputHeight)
 		{
-			++taskSize;
-			--numUnassignedPixels;
+			m_pThreadPool->ParallelFor(numTiles, [&](uint32_t tileIndex)
+				{
+					const int startX = (tileIndex % GetNumTilesX()) * m_TileSize;
+					const int startY = (tileIndex / GetNumTilesX()) * m_TileSize;
+					m_pFrameBuffer->Resolve(startX, startY, std::min(startX + static_cast<int>(m_TileSize), m_Width), std::min(startY + static_cast<int>(m_TileSize), m_Height));
+				});
 		}
-		//= is to acces all the locals
-		//this is to acces the member variables
-		async_futures.push_back(std::async(std::launch::async, [=, this]
-			{
-				const uint32_t pixelIndexEnd = currPixelIndex + taskSize;
-				for (uint32_t pixelIndex{ currPixelIndex }; pixelIndex < pixelIndexEnd; ++pixelIndex)
+		else
+		{
+			//The traced tiles don't map onto pixels anymore, the upscale goes over bands of whole rows
+			const uint32_t numBands{ (outputHeight + m_TileSize - 1) / m_TileSize };
+			m_pThreadPool->ParallelFor(numBands, [&](uint32_t bandIndex)
 				{
-					RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials);
-				}
-			}));
+					const int startY = bandIndex * m_TileSize;
+					m_pFrameBuffer->ResolveScaled(0, startY, outputWidth, std::min(startY + static_cast<int>(m_TileSize), outputHeight), m_Width, m_Height);
+				});
+		}
+	}
+
+	//Frames that trace nothing would make the controller think any resolution is cheap, they returned above
+	if (m_DynamicResolutionEnabled && !isProgressive && !isIdle)
+		UpdateRenderScale(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
 
-		currPixelIndex += taskSize;		
+	//@END
+	//Show the frame, nothing to do when headless
+	TRACE_ZONE("FrameBuffer::Present");
+	m_pFrameBuffer->Present();
+}
+
+void dae::Renderer::SetTileSize(uint32_t tileSize)
+{
+	//Packets never straddle two tiles
+	const uint32_t packetMultiple{ std::lcm(RAY_PACKET_WIDTH, RAY_PACKET_HEIGHT) };
+	m_TileSize = std::max(packetMultiple, (tileSize + packetMultiple - 1) / packetMultiple * packetMultiple);
+	m_IsFrameValid = false;
+}
+
+void dae::Renderer::ToggleProgressive()
+{
+	SetProgressive(!m_ProgressiveEnabled);
+	std::cout << (m_ProgressiveEnabled ? "Progressive accumulation on\n" : "Progressive accumulation off\n");
+}
+
+void dae::Renderer::SetProgressiveTargets(uint32_t maxSampleCount, float varianceTarget)
+{
+	m_MaxSampleCount = std::max(maxSampleCount, 1u);
+	m_VarianceTarget = varianceTarget;
+	m_IsFrameValid = false;
+}
+
+void dae::Renderer::ToggleDynamicResolution()
+{
+	SetDynamicResolution(!m_DynamicResolutionEnabled);
+	std::cout << (m_DynamicResolutionEnabled ? "Dynamic resolution on, target " : "Dynamic resolution off, target ") << m_TargetFrameTime << " ms\n";
+}
+
+void dae::Renderer::SetTargetFrameTime(float milliseconds, float hysteresis)
+{
+	m_TargetFrameTime = std::max(milliseconds, 0.1f);
+	m_FrameTimeHysteresis = std::clamp(hysteresis, 0.f, 0.9f);
+	m_FramesSinceScaleChange = 0;
+}
+
+bool dae::Renderer::ApplyRenderScale(bool isProgressive, bool isIdle)
+{
+	if (!m_DynamicResolutionEnabled || isProgressive)
+	{
+		m_RenderScale = 1.f;
+		m_FramesSinceScaleChange = 0;
 	}
 
-	for (const std::future<void>& f : async_futures)
+	//The controller keeps its scale while idle, the view goes back to it as soon as it changes again
+	const float renderScale{ isIdle ? 1.f : m_RenderScale };
+	const int width{ std::max(static_cast<int>(m_pFrameBuffer->GetWidth() * renderScale + 0.5f), 1) };
+	const int height{ std::max(static_cast<int>(m_pFrameBuffer->GetHeight() * renderScale + 0.5f), 1) };
+	if (width == m_Width && height == m_Height)
+		return false;
+
+	m_Width = width;
+	m_Height = height;
+	return true;
+}
+
+void dae::Renderer::UpdateRenderScale(float frameTime)
+{
+	m_AverageFrameTime = m_FramesSinceScaleChange == 0 ? frameTime : m_AverageFrameTime + (frameTime - m_AverageFrameTime) * 0.25f;
+	if (++m_FramesSinceScaleChange < RENDER_SCALE_SETTLE_FRAMES)
+		return;
+
+	//Inside the band the resolution stays, a frame time right at the target would flip between two scales otherwise
+	const bool isTooSlow{ m_AverageFrameTime > m_TargetFrameTime * (1.f + m_FrameTimeHysteresis) };
+	const bool isTooFast{ m_AverageFrameTime < m_TargetFrameTime * (1.f - m_FrameTimeHysteresis) };
+	if (!isTooSlow && !isTooFast)
+		return;
+
+	//Tracing time goes with the pixel count, the square of the scale. Rounded down so a step up doesn't land just above the target
+	const float idealScale{ m_RenderScale * std::sqrt(m_TargetFrameTime / m_AverageFrameTime) };
+	const float renderScale{ std::clamp(std::floor(idealScale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP, MIN_RENDER_SCALE, 1.f) };
+	if (renderScale == m_RenderScale)
+		return;
+
+	m_RenderScale = renderScale;
+	m_FramesSinceScaleChange = 0;
+}
+
+void dae::Renderer::ToggleReprojection()
+{
+	SetReprojection(!m_ReprojectionEnabled);
+	std::cout << (m_ReprojectionEnabled ? "Reprojection on\n" : "Reprojection off\n");
+}
+
+void dae::Renderer::SetThreadCount(uint32_t threadCount, ThreadPinning pinning)
+{
+	delete m_pThreadPool;
+	m_pThreadPool = new ThreadPool(threadCount, pinning);
+}
+
+uint32_t dae::Renderer::GetThreadCount() const
+{
+	return m_pThreadPool->GetThreadCount();
+}
+
+uint32_t dae::Renderer::GetNumTilesX() const
+{
+	return (m_Width + m_TileSize - 1) / m_TileSize;
+}
+
+uint32_t dae::Renderer::GetNumTiles() const
+{
+	return GetNumTilesX() * ((m_Height + m_TileSize - 1) / m_TileSize);
+}
+
+void dae::Renderer::ResetAccumulation(bool isProgressive)
+{
+	m_ConvergedTileCount = 0;
+	m_TileConverged.assign(GetNumTiles(), 0);
+	m_TileSampleCounts.assign(GetNumTiles(), 0);
+	m_TileErrors.assign(GetNumTiles(), 0.f);
+
+	//Nothing reads the planes outside progressive frames, e.g. the cost heatmap ignores the progressive mode
+	if (!isProgressive)
+		return;
+
+	const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+	m_AccumulatedRed.assign(pixelCount, 0.f);
+	m_AccumulatedGreen.assign(pixelCount, 0.f);
+	m_AccumulatedBlue.assign(pixelCount, 0.f);
+	m_AccumulatedLuminance.assign(pixelCount, 0.f);
+	m_AccumulatedLuminanceSquared.assign(pixelCount, 0.f);
+}
+
+void dae::Renderer::AccumulateTile(uint32_t tileIndex)
+{
+	const int startX = (tileIndex % GetNumTilesX()) * m_TileSize;
+	const int startY = (tileIndex / GetNumTilesX()) * m_TileSize;
+	const int endX = std::min(startX + static_cast<int>(m_TileSize), m_Width);
+	const int endY = std::min(startY + static_cast<int>(m_TileSize), m_Height);
+
+	float* pRed{ m_pFrameBuffer->GetRed() };
+	float* pGreen{ m_pFrameBuffer->GetGreen() };
+	float* pBlue{ m_pFrameBuffer->GetBlue() };
+
+	const uint32_t sampleCount{ ++m_TileSampleCounts[tileIndex] };
+	const float invSampleCount{ 1.f / sampleCount };
+	bool isConverged{ true };
+	float tileError{};
+	for (int py{ startY }; py < endY; ++py)
 	{
-		f.wait();
+		for (int px{ startX }; px < endX; ++px)
+		{
+			const size_t pixelIndex{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+			//Resolved pixels never get brighter than 1, highlights above that look the same whatever their variance
+			const float luminance{ std::min(0.2126f * pRed[pixelIndex] + 0.7152f * pGreen[pixelIndex] + 0.0722f * pBlue[pixelIndex], 1.f) };
+
+			m_AccumulatedRed[pixelIndex] += pRed[pixelIndex];
+			m_AccumulatedGreen[pixelIndex] += pGreen[pixelIndex];
+			m_AccumulatedBlue[pixelIndex] += pBlue[pixelIndex];
+			m_AccumulatedLuminance[pixelIndex] += luminance;
+			m_AccumulatedLuminanceSquared[pixelIndex] += luminance * luminance;
+
+			pRed[pixelIndex] = m_AccumulatedRed[pixelIndex] * invSampleCount;
+			pGreen[pixelIndex] = m_AccumulatedGreen[pixelIndex] * invSampleCount;
+			pBlue[pixelIndex] = m_AccumulatedBlue[pixelIndex] * invSampleCount;
+
+			//Variance of the mean luminance is the sample variance divided by the sample count
+			const float meanLuminance{ m_AccumulatedLuminance[pixelIndex] * invSampleCount };
+			const float variance{ std::max(m_AccumulatedLuminanceSquared[pixelIndex] * invSampleCount - meanLuminance * meanLuminance, 0.f) };
+			const float error{ variance * invSampleCount };
+			isConverged &= error <= m_VarianceTarget;
+			tileError += error;
+		}
 	}
 
-#elif defined(PARALLEL_FOR)
-	Concurrency::parallel_for(0u, numPixels, [=, this](int i) {
-		RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
+	m_TileErrors[tileIndex] = tileError;
+
+	if (sampleCount >= m_MaxSampleCount || (sampleCount >= PROGRESSIVE_MIN_SAMPLE_COUNT && isConverged))
+		m_TileConverged[tileIndex] = 1;
+}
+
+void dae::Renderer::PlanTileSamples()
+{
+	const uint32_t numTiles{ GetNumTiles() };
+	m_TileFrameSampleCounts.assign(numTiles, 0);
+
+	//A frame costs about as much as a uniform one, one sample per tile, no matter how many tiles converged already
+	uint32_t sampleBudget{ numTiles };
+	for (uint32_t tileIndex{}; tileIndex < numTiles; ++tileIndex)
+	{
+		//Too few samples to trust the variance, e.g. every sample so far landed on the same side of a shadow edge
+		if (!m_TileConverged[tileIndex] && m_TileSampleCounts[tileIndex] < PROGRESSIVE_MIN_SAMPLE_COUNT)
+		{
+			m_TileFrameSampleCounts[tileIndex] = 1;
+			--sampleBudget;
+		}
+	}
+
+	//Most samples a tile can still take this frame, 0 for the converged ones and the ones still warming up
+	const auto getCapacity = [&](uint32_t tileIndex)
+		{
+			if (m_TileConverged[tileIndex] || m_TileSampleCounts[tileIndex] < PROGRESSIVE_MIN_SAMPLE_COUNT)
+				return 0u;
+
+			const uint32_t samplesLeft{ m_MaxSampleCount - m_TileSampleCounts[tileIndex] };
+			return std::min(samplesLeft, PROGRESSIVE_MAX_TILE_SAMPLES_PER_FRAME) - m_TileFrameSampleCounts[tileIndex];
+		};
+
+	//Split in proportion to the error left, the fractions carry over to the next tile.
+	//What a capped tile can't take is split again over the tiles that still can, until the budget is spent or every tile is full
+	while (sampleBudget > 0)
+	{
+		float totalError{};
+		for (uint32_t tileIndex{}; tileIndex < numTiles; ++tileIndex)
+		{
+			if (getCapacity(tileIndex) > 0)
+				totalError += m_TileErrors[tileIndex];
+		}
+		if (totalError <= 0.f)
+			return;
+
+		const uint32_t roundBudget{ sampleBudget };
+		float carriedSamples{};
+		for (uint32_t tileIndex{}; tileIndex < numTiles && sampleBudget > 0; ++tileIndex)
+		{
+			const uint32_t capacity{ getCapacity(tileIndex) };
+			if (capacity == 0)
+				continue;
+
+			carriedSamples += roundBudget * (m_TileErrors[tileIndex] / totalError);
+			const uint32_t sampleCount{ std::min({ static_cast<uint32_t>(carriedSamples), capacity, sampleBudget }) };
+			carriedSamples -= sampleCount;
+
+			m_TileFrameSampleCounts[tileIndex] += sampleCount;
+			sampleBudget -= sampleCount;
+		}
+
+		//Only fractions were left, too little for any tile
+		if (sampleBudget == roundBudget)
+			return;
+	}
+}
+
+SampleDistribution dae::Renderer::GetSampleDistribution() const
+{
+	SampleDistribution distribution{};
+	if (!m_ProgressiveEnabled || m_TileSampleCounts.empty() || m_AccumulatedRed.empty())
+		return distribution;
+
+	distribution.minSamplesPerPixel = UINT32_MAX;
+	double varianceSum{};
+	double errorSum{};
+	for (uint32_t tileIndex{}; tileIndex < m_TileSampleCounts.size(); ++tileIndex)
+	{
+		const uint32_t sampleCount{ m_TileSampleCounts[tileIndex] };
+		if (sampleCount == 0)
+			continue;
+
+		const int startX = (tileIndex % GetNumTilesX()) * m_TileSize;
+		const int startY = (tileIndex / GetNumTilesX()) * m_TileSize;
+		const int endX = std::min(startX + static_cast<int>(m_TileSize), m_Width);
+		const int endY = std::min(startY + static_cast<int>(m_TileSize), m_Height);
+		const uint64_t pixelCount{ static_cast<uint64_t>(endX - startX) * (endY - startY) };
+
+		distribution.pixelCount += pixelCount;
+		distribution.sampleCount += pixelCount * sampleCount;
+		distribution.minSamplesPerPixel = std::min(distribution.minSamplesPerPixel, sampleCount);
+		distribution.maxSamplesPerPixel = std::max(distribution.maxSamplesPerPixel, sampleCount);
+		distribution.histogram[std::min(static_cast<uint32_t>(std::bit_width(sampleCount)) - 1, SAMPLE_HISTOGRAM_BUCKETS - 1)] += pixelCount;
+
+		const double invSampleCount{ 1.0 / sampleCount };
+		for (int py{ startY }; py < endY; ++py)
+		{
+			for (int px{ startX }; px < endX; ++px)
+			{
+				const size_t pixelIndex{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+				const double meanLuminance{ m_AccumulatedLuminance[pixelIndex] * invSampleCount };
+				const double variance{ std::max(m_AccumulatedLuminanceSquared[pixelIndex] * invSampleCount - meanLuminance * meanLuminance, 0.0) };
+				varianceSum += variance;
+				errorSum += variance * invSampleCount;
+			}
+		}
+	}
+
+	if (distribution.pixelCount == 0)
+		return {};
+
+	//With uniform sampling every pixel has the same count n, the mean error is then the mean variance over n
+	distribution.meanError = errorSum / distribution.pixelCount;
+	distribution.uniformSamplesPerPixel = errorSum > 0.0 ? varianceSum / errorSum : 1.0;
+	return distribution;
+}
+
+uint64_t dae::Renderer::ReprojectFrame(const Camera& camera, float fov, float aspectRatio)
+{
+	TRACE_ZONE("Renderer::ReprojectFrame");
+
+	//The frame buffer still holds the last frame, it gets overwritten by the reprojected one
+	const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+	m_HistoryRed.assign(m_pFrameBuffer->GetRed(), m_pFrameBuffer->GetRed() + pixelCount);
+	m_HistoryGreen.assign(m_pFrameBuffer->GetGreen(), m_pFrameBuffer->GetGreen() + pixelCount);
+	m_HistoryBlue.assign(m_pFrameBuffer->GetBlue(), m_pFrameBuffer->GetBlue() + pixelCount);
+	m_HistoryDepths.swap(m_PixelDepths);
+	m_PixelDepths.resize(pixelCount);
+	m_ReprojectionTargets.assign(pixelCount, UINT64_MAX);
+	m_TraceMask.resize(pixelCount);
+
+	const Vector3 right{ camera.cameraToWorld.GetAxisX() };
+	const Vector3 up{ camera.cameraToWorld.GetAxisY() };
+	const Vector3 forward{ camera.cameraToWorld.GetAxisZ() };
+
+	//Every hit of the last frame lands on the pixel its point projects to in the new view, the closest one wins
+	m_pThreadPool->ParallelFor(m_Height, [&](uint32_t py)
+		{
+			for (int px{}; px < m_Width; ++px)
+			{
+				const size_t sourceIndex{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+				const float depth{ m_HistoryDepths[sourceIndex] };
+				if (depth == FLT_MAX)
+					continue;
+
+				//The primary ray of the last frame through this pixel, see GetViewDirection
+				const float cx{ (((2 * (px + 0.5f) / static_cast<float>(m_Width)) - 1) * m_HistoryAspectRatio) * m_HistoryFov };
+				const float cy{ (1 - (2 * (py + 0.5f) / static_cast<float>(m_Height))) * m_HistoryFov };
+				Vector3 direction{ m_HistoryCameraToWorld.TransformVector(cx, cy, 1) };
+				direction.Normalize();
+
+				const Vector3 toPoint{ m_HistoryOrigin + direction * depth - camera.origin };
+				const float viewZ{ Vector3::Dot(toPoint, forward) };
+				if (viewZ <= 0.f)
+					continue;
+
+				const float screenX{ (Vector3::Dot(toPoint, right) / (viewZ * fov * aspectRatio) + 1) * 0.5f * m_Width };
+				const float screenY{ (1 - Vector3::Dot(toPoint, up) / (viewZ * fov)) * 0.5f * m_Height };
+				if (!(screenX >= 0.f && screenX < m_Width && screenY >= 0.f && screenY < m_Height))
+					continue;
+
+				//Distances are positive, their bits order like the floats so the closest splat has the smallest key
+				const uint64_t key{ (static_cast<uint64_t>(std::bit_cast<uint32_t>(toPoint.Magnitude())) << 32) | sourceIndex };
+				std::atomic_ref<uint64_t> target{ m_ReprojectionTargets[static_cast<size_t>(screenX) + static_cast<size_t>(screenY) * m_Width] };
+				uint64_t current{ target.load(std::memory_order_relaxed) };
+				while (key < current && !target.compare_exchange_weak(current, key, std::memory_order_relaxed))
+				{
+				}
+			}
 		});
-#else
-	for (uint32_t i{}; i < numPixels; ++i)
+
+	const auto getDepth = [](uint64_t key) { return std::bit_cast<float>(static_cast<uint32_t>(key >> 32)); };
+	const uint32_t refreshPhase{ m_ReprojectionFrame++ % REPROJECTION_REFRESH_INTERVAL };
+
+	m_pThreadPool->ParallelFor(m_Height, [&](uint32_t py)
+		{
+			for (int px{}; px < m_Width; ++px)
+			{
+				const size_t pixelIndex{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+				const uint64_t key{ m_ReprojectionTargets[pixelIndex] };
+
+				//Nothing landed here, e.g. a disoccluded area or one that just came into view.
+				//A rotating subset is traced anyway, view dependent shading and detail lost to resampling catch up over a few frames
+				//Whole packets are refreshed, a packet with a few scattered lanes costs about as much as a full one
+				const uint32_t packetX{ px / RAY_PACKET_WIDTH };
+				const uint32_t packetY{ py / RAY_PACKET_HEIGHT };
+				bool needsTrace{ key == UINT64_MAX || (packetX + packetY * 3) % REPROJECTION_REFRESH_INTERVAL == refreshPhase };
+				if (!needsTrace)
+				{
+					//A splat much further away than a neighbour is likely background seen through a gap between the splats of a closer surface
+					const float maxDepth{ getDepth(key) * (1.f - REPROJECTION_DEPTH_TOLERANCE) };
+					const auto isCloser = [&](size_t neighbourIndex)
+						{
+							return m_ReprojectionTargets[neighbourIndex] != UINT64_MAX && getDepth(m_ReprojectionTargets[neighbourIndex]) < maxDepth;
+						};
+					needsTrace = (px > 0 && isCloser(pixelIndex - 1)) || (px + 1 < m_Width && isCloser(pixelIndex + 1))
+						|| (py > 0 && isCloser(pixelIndex - m_Width)) || (py + 1 < static_cast<uint32_t>(m_Height) && isCloser(pixelIndex + m_Width));
+				}
+
+				m_TraceMask[pixelIndex] = needsTrace;
+				if (needsTrace)
+					continue;
+
+				const size_t sourceIndex{ static_cast<size_t>(key & UINT32_MAX) };
+				m_pFrameBuffer->GetRed()[pixelIndex] = m_HistoryRed[sourceIndex];
+				m_pFrameBuffer->GetGreen()[pixelIndex] = m_HistoryGreen[sourceIndex];
+				m_pFrameBuffer->GetBlue()[pixelIndex] = m_HistoryBlue[sourceIndex];
+				m_PixelDepths[pixelIndex] = getDepth(key);
+			}
+		});
+
+	return pixelCount - static_cast<uint64_t>(std::count(m_TraceMask.begin(), m_TraceMask.end(), uint8_t{ 1 }));
+}
+
+bool dae::Renderer::NeedsTrace(int px, int py) const
+{
+	return !m_IsReprojecting || m_TraceMask[static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width];
+}
+
+void dae::Renderer::RenderTile(Scene* pScene, uint32_t tileIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials, RenderStatistics& statistics)
+{
+	TRACE_ZONE("Renderer::RenderTile");
+
+	//Every counter the tile touches ends up in the thread statistics, tiles of one worker never overlap
+	RenderStatistics& threadStatistics{ Statistics::GetThreadStatistics() };
+	threadStatistics = {};
+
+	const int startX = (tileIndex % GetNumTilesX()) * m_TileSize;
+	const int startY = (tileIndex / GetNumTilesX()) * m_TileSize;
+	const int endX = std::min(startX + static_cast<int>(m_TileSize), m_Width);
+	const int endY = std::min(startY + static_cast<int>(m_TileSize), m_Height);
+
+	if (m_CurrentLightingMode == LightingMode::Cost)
 	{
-		RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
+		//One ray at a time, a packet can't tell which of its pixels the work was done for
+		for (int py{ startY }; py < endY; ++py)
+		{
+			for (int px{ startX }; px < endX; ++px)
+			{
+				MeasurePixelCost(pScene, px + py * m_Width, fov, aspectRatio, camera, lights, materials);
+			}
+		}
 	}
-#endif
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	else if (m_PacketTracingEnabled)
+	{
+		for (int py{ startY }; py < endY; py += RAY_PACKET_HEIGHT)
+		{
+			for (int px{ startX }; px < endX; px += RAY_PACKET_WIDTH)
+			{
+				RenderPacket(pScene, px, py, fov, aspectRatio, camera, lights, materials);
+			}
+		}
+	}
+	else
+	{
+		for (int py{ startY }; py < endY; ++py)
+		{
+			for (int px{ startX }; px < endX; ++px)
+			{
+				if (NeedsTrace(px, py))
+					RenderPixel(pScene, px + py * m_Width, fov, aspectRatio, camera, lights, materials);
+			}
+		}
+	}
+
+	statistics = threadStatistics;
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials)
 {
+	RenderStatistics& statistics{ Statistics::GetThreadStatistics() };
+
 	const int px = pixelIndex % m_Width;
 	const int py = pixelIndex / m_Width;
 
-	//Convert from raster space to camera space
-	float cx = (((2 * (px + 0.5f) / (float) m_Width) - 1) * aspectRatio) * fov;
-	float cy = (1 - (2 * (py + 0.5f) / (float) m_Height)) * fov;
-
-	Vector3 rayDirection{ cx,cy,1 };
-	rayDirection = camera.cameraToWorld.TransformVector(rayDirection);
-	rayDirection.Normalize();
+	const Vector3 rayDirection{ GetViewDirection(px, py, fov, aspectRatio, camera) };
 
 	Ray viewRay{ camera.origin, rayDirection };
 
@@ -110,6 +661,7 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 	HitRecord closestHit{};
 
 	pScene->GetClosestHit(viewRay, closestHit);
+	++statistics.primaryRays;
 
 	if (closestHit.didHit)
 	{
@@ -121,67 +673,170 @@ void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, f
 			float distance = directionToLightFunction.Normalize();
 
 			Ray invLightRay{ closestHit.origin, directionToLightFunction, 0.001f, distance };
-			if (m_ShadowsEnabled && pScene->DoesHit(invLightRay)) continue;
-
-			switch (m_CurrentLightingMode)
+			if (m_ShadowsEnabled)
 			{
-			case dae::Renderer::LightingMode::ObservedArea:
-			{
-				//calculate the observed area lighting with Lambert's cosine law
-				float observedArea = Vector3::Dot(closestHit.normal, directionToLightFunction);
-				if (observedArea < 0)
+				++statistics.shadowRays;
+				if (pScene->DoesHit(invLightRay))
+				{
+					++statistics.occludedShadowRays;
 					continue;
-
-				finalColor += ColorRGB{ observedArea, observedArea, observedArea };
-				break;
+				}
 			}
-			case dae::Renderer::LightingMode::Radiance:
-			{
-				auto lightRadiance{ LightUtils::GetRadiance(lights[i], closestHit.origin) };
 
-				finalColor += lightRadiance;
-				break;
-			}
-			case dae::Renderer::LightingMode::BRDF:
-			{
-				ColorRGB BRDFColour{ materials[closestHit.materialIndex]->Shade(closestHit, -directionToLightFunction, rayDirection) };
+			TRACE_ZONE("Material::Shade");
+			finalColor += ShadeLight(closestHit, lights[i], directionToLightFunction, rayDirection, materials);
+		}
+	}
 
-				finalColor += BRDFColour;
-				break;
-			}
-			case dae::Renderer::LightingMode::Combined:
+	WritePixel(px, py, finalColor);
+	WriteDepth(px, py, closestHit.t);
+}
+
+void dae::Renderer::RenderPacket(Scene* pScene, int startX, int startY, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials)
+{
+	RenderStatistics& statistics{ Statistics::GetThreadStatistics() };
+
+	//Lanes that fall outside the screen stay inactive
+	RayPacket viewPacket{};
+	for (uint32_t lane{}; lane < RAY_PACKET_SIZE; ++lane)
+	{
+		const int px = startX + lane % RAY_PACKET_WIDTH;
+		const int py = startY + lane / RAY_PACKET_WIDTH;
+		if (px < m_Width && py < m_Height && NeedsTrace(px, py))
+			viewPacket.SetRay(lane, { camera.origin, GetViewDirection(px, py, fov, aspectRatio, camera) });
+	}
+
+	//Every pixel of the packet was reprojected
+	if (viewPacket.activeMask == 0)
+		return;
+
+	HitRecord closestHits[RAY_PACKET_SIZE]{};
+	pScene->GetClosestHit(viewPacket, closestHits);
+	statistics.primaryRays += std::popcount(viewPacket.activeMask);
+
+	uint32_t hitMask{};
+	GeometryUtils::ForEachLane(viewPacket.activeMask, [&](uint32_t lane)
+		{
+			if (closestHits[lane].didHit)
+				hitMask |= 1u << lane;
+		});
+
+	ColorRGB finalColors[RAY_PACKET_SIZE]{};
+	for (const Light& light : lights)
+	{
+		//One shadow ray per hit lane, all of them aim at the same light
+		RayPacket lightPacket{};
+		Vector3 directionsToLight[RAY_PACKET_SIZE]{};
+		GeometryUtils::ForEachLane(hitMask, [&](uint32_t lane)
 			{
-				float observedArea = Vector3::Dot(closestHit.normal, directionToLightFunction);
-				if (observedArea < 0)
-					continue;
+				directionsToLight[lane] = LightUtils::GetDirectionToLight(light, closestHits[lane].origin);
+				const float distance{ directionsToLight[lane].Normalize() };
+				lightPacket.SetRay(lane, { closestHits[lane].origin, directionsToLight[lane], 0.001f, distance });
+			});
 
-				//inverse direction to get the correct direction from the light to the point
-				//we originally calculate from the point to the light
-				ColorRGB BRDFColour{ materials[closestHit.materialIndex]->Shade(closestHit, -directionToLightFunction, rayDirection) };
-				auto lightRadiance{ LightUtils::GetRadiance(lights[i], closestHit.origin) };
-				finalColor += lightRadiance * BRDFColour * ColorRGB{ observedArea, observedArea, observedArea };
-				break;
-			}
-			}
+		uint32_t occludedMask{};
+		if (m_ShadowsEnabled)
+		{
+			occludedMask = pScene->DoesHit(lightPacket);
+			statistics.shadowRays += std::popcount(hitMask);
+			statistics.occludedShadowRays += std::popcount(occludedMask);
 		}
+		//One zone per packet, a zone per lane would cost more than the shading itself
+		TRACE_ZONE("Material::Shade");
+		GeometryUtils::ForEachLane(hitMask & ~occludedMask, [&](uint32_t lane)
+			{
+				const Vector3 viewDirection{ viewPacket.directionX[lane], viewPacket.directionY[lane], viewPacket.directionZ[lane] };
+				finalColors[lane] += ShadeLight(closestHits[lane], light, directionsToLight[lane], viewDirection, materials);
+			});
+	}
+
+	GeometryUtils::ForEachLane(viewPacket.activeMask, [&](uint32_t lane)
+		{
+			WritePixel(startX + lane % RAY_PACKET_WIDTH, startY + lane / RAY_PACKET_WIDTH, finalColors[lane]);
+			WriteDepth(startX + lane % RAY_PACKET_WIDTH, startY + lane / RAY_PACKET_WIDTH, closestHits[lane].t);
+		});
+}
+
+Vector3 dae::Renderer::GetViewDirection(int px, int py, float fov, float aspectRatio, const Camera& camera) const
+{
+	//Convert from raster space to camera space
+	float cx = (((2 * (px + g_SampleOffsetX) / (float) m_Width) - 1) * aspectRatio) * fov;
+	float cy = (1 - (2 * (py + g_SampleOffsetY) / (float) m_Height)) * fov;
+
+	Vector3 rayDirection{ cx,cy,1 };
+	rayDirection = camera.cameraToWorld.TransformVector(rayDirection);
+	rayDirection.Normalize();
+
+	return rayDirection;
+}
+
+ColorRGB dae::Renderer::ShadeLight(const HitRecord& hitRecord, const Light& light, const Vector3& directionToLight, const Vector3& viewDirection, const std::vector<Material>& materials) const
+{
+	++Statistics::GetThreadStatistics().shadeCalls;
+
+	switch (m_CurrentLightingMode)
+	{
+	case dae::Renderer::LightingMode::ObservedArea:
+	{
+		//calculate the observed area lighting with Lambert's cosine law
+		float observedArea = Vector3::Dot(hitRecord.normal, directionToLight);
+		if (observedArea < 0)
+			return {};
+
+		return ColorRGB{ observedArea, observedArea, observedArea };
 	}
+	case dae::Renderer::LightingMode::Radiance:
+	{
+		return LightUtils::GetRadiance(light, hitRecord.origin);
+	}
+	case dae::Renderer::LightingMode::BRDF:
+	{
+		return materials[hitRecord.materialIndex].Shade(hitRecord, -directionToLight, viewDirection);
+	}
+	case dae::Renderer::LightingMode::Cost:
+		//Shades like Combined, so the measured cost is the cost of a normal frame
+	case dae::Renderer::LightingMode::Combined:
+	{
+		float observedArea = Vector3::Dot(hitRecord.normal, directionToLight);
+		if (observedArea < 0)
+			return {};
+
+		//inverse direction to get the correct direction from the light to the point
+		//we originally calculate from the point to the light
+		ColorRGB BRDFColour{ materials[hitRecord.materialIndex].Shade(hitRecord, -directionToLight, viewDirection) };
+		auto lightRadiance{ LightUtils::GetRadiance(light, hitRecord.origin) };
+		return lightRadiance * BRDFColour * ColorRGB{ observedArea, observedArea, observedArea };
+	}
+	}
+
+	return {};
+}
 
-	//Update Color in Buffer
-	finalColor.MaxToOne();
+void dae::Renderer::WritePixel(int px, int py, const ColorRGB& color)
+{
+	//Linear and unclamped, tone mapping and packing happen in the resolve pass
+	const size_t pixelIndex{ static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width };
+	m_pFrameBuffer->GetRed()[pixelIndex] = color.r;
+	m_pFrameBuffer->GetGreen()[pixelIndex] = color.g;
+	m_pFrameBuffer->GetBlue()[pixelIndex] = color.b;
+}
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+void dae::Renderer::WriteDepth(int px, int py, float depth)
+{
+	if (!m_PixelDepths.empty())
+		m_PixelDepths[static_cast<size_t>(px) + static_cast<size_t>(py) * m_Width] = depth;
 }
 
 bool Renderer::SaveBufferToImage() const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	//Keeps the SDL convention of returning true on failure
+	return !m_pFrameBuffer->SaveToBMP("RayTracing_Buffer.bmp");
 }
 
 void dae::Renderer::CycleLightingMode()
 {
+	m_IsFrameValid = false;
+
 	switch (m_CurrentLightingMode)
 	{
 	case dae::Renderer::LightingMode::ObservedArea:
@@ -197,6 +852,10 @@ void dae::Renderer::CycleLightingMode()
 		std::cout << "Change to Combined\n";
 		break;
 	case dae::Renderer::LightingMode::Combined:
+		m_CurrentLightingMode = LightingMode::Cost;
+		std::cout << "Change to Cost\n";
+		break;
+	case dae::Renderer::LightingMode::Cost:
 		m_CurrentLightingMode = LightingMode::ObservedArea;
 		std::cout << "Change to ObservedArea\n";
 		break;
@@ -204,3 +863,95 @@ void dae::Renderer::CycleLightingMode()
 		break;
 	}
 }
+
+void dae::Renderer::CycleCostMetric()
+{
+	m_IsFrameValid = false;
+
+	switch (m_CostMetric)
+	{
+	case dae::Renderer::CostMetric::Time:
+		m_CostMetric = CostMetric::NodeVisits;
+		std::cout << "Cost shows node visits\n";
+		break;
+	case dae::Renderer::CostMetric::NodeVisits:
+		m_CostMetric = CostMetric::PrimitiveTests;
+		std::cout << "Cost shows primitive tests\n";
+		break;
+	case dae::Renderer::CostMetric::PrimitiveTests:
+		m_CostMetric = CostMetric::Time;
+		std::cout << "Cost shows nanoseconds\n";
+		break;
+	default:
+		break;
+	}
+}
+
+void dae::Renderer::MeasurePixelCost(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials)
+{
+	const RenderStatistics& statistics{ Statistics::GetThreadStatistics() };
+	const RenderStatistics statisticsBefore{ statistics };
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+	RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials);
+	const auto endTime{ std::chrono::steady_clock::now() };
+
+	float cost{};
+	switch (m_CostMetric)
+	{
+	case dae::Renderer::CostMetric::Time:
+		cost = std::chrono::duration<float, std::nano>(endTime - startTime).count();
+		break;
+	case dae::Renderer::CostMetric::NodeVisits:
+		cost = static_cast<float>(statistics.nodeVisits - statisticsBefore.nodeVisits);
+		break;
+	case dae::Renderer::CostMetric::PrimitiveTests:
+		cost = static_cast<float>((statistics.sphereTests - statisticsBefore.sphereTests)
+			+ (statistics.planeTests - statisticsBefore.planeTests)
+			+ (statistics.triangleTests - statisticsBefore.triangleTests));
+		break;
+	}
+
+	m_PixelCosts[pixelIndex] = cost;
+}
+
+void dae::Renderer::WriteCostHeatmap()
+{
+	//Scaled to the 99th percentile, a few preempted pixels would otherwise push everything else to black
+	std::vector<float> sortedCosts{ m_PixelCosts };
+	const auto percentile{ sortedCosts.begin() + sortedCosts.size() * 99 / 100 };
+	std::nth_element(sortedCosts.begin(), percentile, sortedCosts.end());
+	const float scale{ *percentile > 0.f ? 1.f / *percentile : 0.f };
+
+	const ColorRGB heatColors[]{ { 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+	constexpr int lastHeatColor{ static_cast<int>(std::size(heatColors)) - 1 };
+
+	m_pThreadPool->ParallelFor(m_Height, [&](uint32_t py)
+		{
+			for (int px{}; px < m_Width; ++px)
+			{
+				const float heat{ std::min(m_PixelCosts[px + py * m_Width] * scale, 1.f) * lastHeatColor };
+				const int heatColor{ std::min(static_cast<int>(heat), lastHeatColor - 1) };
+				WritePixel(px, py, ColorRGB::Lerp(heatColors[heatColor], heatColors[heatColor + 1], heat - heatColor));
+			}
+		});
+}
+
+bool dae::Renderer::SaveCostImage(const std::string& path) const
+{
+	if (m_PixelCosts.empty())
+		return false;
+
+	std::ofstream fileStream{ path, std::ios::binary };
+	if (!fileStream)
+		return false;
+
+	//Grayscale PFM, a negative scale marks little endian, rows go from bottom to top
+	fileStream << "Pf\n" << m_Width << " " << m_Height << "\n-1.0\n";
+	for (int py{ m_Height - 1 }; py >= 0; --py)
+	{
+		fileStream.write(reinterpret_cast<const char*>(&m_PixelCosts[static_cast<size_t>(py) * m_Width]), m_Width * sizeof(float));
+	}
+
+	return fileStream.good();
+}
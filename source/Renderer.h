@@ -1,56 +1,227 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
-struct SDL_Window;
-struct SDL_Surface;
+#include "Matrix.h"
+#include "RenderStatistics.h"
 
 namespace dae
 {
 	class Scene;
+	class FrameBuffer;
 	class Camera;
 	class Light;
-	class Material;
+	struct Material;
+	struct HitRecord;
+	struct ColorRGB;
+	class ThreadPool;
+	enum class ThreadPinning;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		enum class LightingMode
+		{
+			ObservedArea, //Lambert cosine law
+			Radiance, //Incident radiance
+			BRDF, //Scattering of light
+			Combined, //ObservedArea*Radiance*BRDF
+			Cost //False color render cost of every pixel, see CostMetric
+		};
+
+		//What the Cost lighting mode measures per pixel
+		enum class CostMetric
+		{
+			Time, //Nanoseconds spent on the pixel
+			NodeVisits, //BVH nodes visited by the primary and shadow rays
+			PrimitiveTests //Sphere, plane and triangle tests
+		};
+
+		//Standard error of half a display step
+		static constexpr float DEFAULT_VARIANCE_TARGET{ (0.5f / 255.f) * (0.5f / 255.f) };
+		//The resolution goes up once frames are this fraction faster than the target, down once they are slower
+		static constexpr float DEFAULT_FRAME_TIME_HYSTERESIS{ 0.15f };
+
+		Renderer(FrameBuffer* pFrameBuffer);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		void Render(Scene* pScene);
 
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials);
+		//Renders the RAY_PACKET_WIDTH x RAY_PACKET_HEIGHT block of pixels starting at (startX, startY), primary and shadow rays are traced as packets
+		void RenderPacket(Scene* pScene, int startX, int startY, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials);
 
 		bool SaveBufferToImage() const;
 
 		void CycleLightingMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
+		void SetLightingMode(LightingMode lightingMode) { m_CurrentLightingMode = lightingMode; m_IsFrameValid = false; }
+		LightingMode GetLightingMode() const { return m_CurrentLightingMode; }
+		void CycleCostMetric();
+		void SetCostMetric(CostMetric costMetric) { m_CostMetric = costMetric; m_IsFrameValid = false; }
+		//Raw costs of the last frame rendered in the Cost mode as a little endian .pfm float image, returns false when it couldn't be written
+		bool SaveCostImage(const std::string& path) const;
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; m_IsFrameValid = false; }
+		void TogglePacketTracing() { m_PacketTracingEnabled = !m_PacketTracingEnabled; m_IsFrameValid = false; }
+		//When enabled, Render keeps the last frame without tracing a ray as long as the scene, camera and settings didn't change.
+		//Disable it to trace every frame, e.g. to measure
+		void SetFrameReuse(bool isEnabled) { m_FrameReuseEnabled = isEnabled; }
 
-	private:
-		SDL_Window* m_pWindow{};
+		//Progressive mode: while the view doesn't change, every frame adds jittered samples to an accumulation buffer and shows the mean.
+		//Every tile gets one sample per frame until it has enough for a variance estimate, after that a frame's budget of one sample per tile
+		//goes to the tiles with the most error left. A tile stops being traced once its pixels converged or it got the sample budget,
+		//any change of the view starts over
+		void ToggleProgressive();
+		void SetProgressive(bool isEnabled) { m_ProgressiveEnabled = isEnabled; m_IsFrameValid = false; }
+		/**
+		 * \brief Sets when a tile is done in progressive mode
+		 * \param maxSampleCount samples per pixel after which a tile stops regardless of its variance
+		 * \param varianceTarget a pixel converged once the variance of its mean luminance is below this
+		 */
+		void SetProgressiveTargets(uint32_t maxSampleCount, float varianceTarget);
+		//How the samples of the progressive accumulation are spread over the pixels so far, empty outside progressive mode
+		SampleDistribution GetSampleDistribution() const;
 
-		SDL_Surface* m_pBuffer{};
-		uint32_t* m_pBufferPixels{};
+		//Dynamic resolution: traces at a lower resolution while frames take longer than the target and upscales bilinearly to the frame buffer.
+		//Progressive mode always renders at the full resolution, and so does the first frame after the view stopped changing
+		void ToggleDynamicResolution();
+		void SetDynamicResolution(bool isEnabled) { m_DynamicResolutionEnabled = isEnabled; }
+		//Frame time in milliseconds the resolution is scaled for, the resolution only changes once the average is out of the hysteresis band
+		void SetTargetFrameTime(float milliseconds, float hysteresis = DEFAULT_FRAME_TIME_HYSTERESIS);
+		//Resolution the last frame was traced at
+		int GetRenderWidth() const { return m_Width; }
+		int GetRenderHeight() const { return m_Height; }
 
+		//Reprojection: while the camera moves through a static scene, the last frame is reprojected into the new view with its depths.
+		//Only the pixels nothing landed on, the far side of depth edges and a rotating subset for refresh are traced,
+		//the first frame after the camera stopped traces every pixel again.
+		//Not used in progressive mode or by the cost heatmap, those have to trace every pixel
+		void ToggleReprojection();
+		void SetReprojection(bool isEnabled) { m_ReprojectionEnabled = isEnabled; m_IsFrameValid = false; }
+
+		//Width and height of the square tiles the screen is split into, rounded up to whole packets
+		void SetTileSize(uint32_t tileSize);
+		uint32_t GetTileSize() const { return m_TileSize; }
+		//Replaces the worker threads, threadCount 0 uses every hardware thread
+		void SetThreadCount(uint32_t threadCount, ThreadPinning pinning);
+		uint32_t GetThreadCount() const;
+
+		//Summed over all tiles of the last Render call
+		const RenderStatistics& GetFrameStatistics() const { return m_FrameStatistics; }
+		//Summed over every frame since the last reset, e.g. to report rays per second once a second
+		const RenderStatistics& GetAccumulatedStatistics() const { return m_AccumulatedStatistics; }
+		void ResetAccumulatedStatistics() { m_AccumulatedStatistics = {}; }
+
+	private:
+		FrameBuffer* m_pFrameBuffer{};
+
+		//Resolution that is traced, smaller than the frame buffer while dynamic resolution scales down
 		int m_Width{};
 		int m_Height{};
 
 		bool m_ShadowsEnabled{ true };
-		
-		enum class LightingMode
-		{
-			ObservedArea, //Lambert cosine law
-			Radiance, //Incident radiance
-			BRDF, //Scattering of light
-			Combined //ObservedArea*Radiance*BRDF
-		};
+		bool m_PacketTracingEnabled{ true };
+
+		bool m_FrameReuseEnabled{ true };
+		//The frame buffer holds a frame rendered with the current settings
+		bool m_IsFrameValid{ false };
+
+		bool m_ProgressiveEnabled{ false };
+		uint32_t m_MaxSampleCount{ 256 };
+		float m_VarianceTarget{ DEFAULT_VARIANCE_TARGET };
+		//Samples in the accumulation buffer of every tile
+		std::vector<uint32_t> m_TileSampleCounts{};
+		//Sum of the variance of the mean luminance over the pixels of a tile, what the next samples are spent on
+		std::vector<float> m_TileErrors{};
+		//Samples every tile gets in the frame being rendered
+		std::vector<uint32_t> m_TileFrameSampleCounts{};
+		//Sums of all samples per pixel, only allocated in progressive mode
+		std::vector<float> m_AccumulatedRed{};
+		std::vector<float> m_AccumulatedGreen{};
+		std::vector<float> m_AccumulatedBlue{};
+		//Luminance clamped to what the resolve can show, for the variance estimate
+		std::vector<float> m_AccumulatedLuminance{};
+		std::vector<float> m_AccumulatedLuminanceSquared{};
+		//One flag per tile, set once the tile stops accumulating
+		std::vector<uint8_t> m_TileConverged{};
+		uint32_t m_ConvergedTileCount{};
+
+		bool m_DynamicResolutionEnabled{ false };
+		float m_TargetFrameTime{ 1000.f / 30.f };
+		float m_FrameTimeHysteresis{ DEFAULT_FRAME_TIME_HYSTERESIS };
+		//Fraction of the frame buffer width and height that is traced
+		float m_RenderScale{ 1.f };
+		//Exponential moving average of the frame time in ms since the scale last changed
+		float m_AverageFrameTime{};
+		uint32_t m_FramesSinceScaleChange{};
+
+		bool m_ReprojectionEnabled{ false };
+		//Pixels of this frame are only traced where m_TraceMask is set, the others were reprojected
+		bool m_IsReprojecting{ false };
+		std::vector<uint8_t> m_TraceMask{};
+		//Distance to the primary hit per pixel, FLT_MAX for a miss, only allocated while reprojection is on
+		std::vector<float> m_PixelDepths{};
+		//The frame buffer holds a reprojected frame, the first frame after the camera stopped traces every pixel
+		bool m_IsFrameReprojected{ false };
+		//The last frame and the view it was rendered with, what the next frame is reprojected from
+		bool m_HasHistory{ false };
+		std::vector<float> m_HistoryRed{};
+		std::vector<float> m_HistoryGreen{};
+		std::vector<float> m_HistoryBlue{};
+		std::vector<float> m_HistoryDepths{};
+		Matrix m_HistoryCameraToWorld{};
+		Vector3 m_HistoryOrigin{};
+		float m_HistoryFov{};
+		float m_HistoryAspectRatio{};
+		//Closest splat per pixel, the distance bits above the index of the pixel of the last frame it came from
+		std::vector<uint64_t> m_ReprojectionTargets{};
+		uint32_t m_ReprojectionFrame{};
+
+		ThreadPool* m_pThreadPool{};
+		uint32_t m_TileSize{ 16 };
+
+		//One entry per tile so workers never share a counter, summed once the frame is done
+		std::vector<RenderStatistics> m_TileStatistics{};
+		RenderStatistics m_FrameStatistics{};
+		RenderStatistics m_AccumulatedStatistics{};
+
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
+		CostMetric m_CostMetric{ CostMetric::Time };
+		//One cost per pixel, only allocated and written in the Cost mode
+		std::vector<float> m_PixelCosts{};
+
+		uint32_t GetNumTilesX() const;
+		uint32_t GetNumTiles() const;
+		//Resizes the traced resolution to the scale the controller picked, or the full one while idle, returns true when it changed
+		bool ApplyRenderScale(bool isProgressive, bool isIdle);
+		//Feedback controller, picks the scale for the next frames from the time the traced frames took
+		void UpdateRenderScale(float frameTime);
+		//Starts the progressive accumulation over, the per pixel sums are only cleared for progressive frames
+		void ResetAccumulation(bool isProgressive);
+		//Splats the last frame into the view of the camera and marks the pixels that still have to be traced, returns how many were reprojected
+		uint64_t ReprojectFrame(const Camera& camera, float fov, float aspectRatio);
+		bool NeedsTrace(int px, int py) const;
+		//Fills m_TileFrameSampleCounts, new tiles get one sample and the rest of the budget is split by m_TileErrors
+		void PlanTileSamples();
+		//Adds the sample just traced for a tile to its sums, writes the mean to the frame buffer and checks whether the tile converged
+		void AccumulateTile(uint32_t tileIndex);
+		void RenderTile(Scene* pScene, uint32_t tileIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials, RenderStatistics& statistics);
+		Vector3 GetViewDirection(int px, int py, float fov, float aspectRatio, const Camera& camera) const;
+		//Light reflected towards the camera by one unoccluded light, depends on the lighting mode
+		ColorRGB ShadeLight(const HitRecord& hitRecord, const Light& light, const Vector3& directionToLight, const Vector3& viewDirection, const std::vector<Material>& materials) const;
+		//Stores the linear color of a pixel in the frame buffer, Render resolves it to a pixel once the frame is traced
+		void WritePixel(int px, int py, const ColorRGB& color);
+		//Stores the distance to the primary hit for the reprojection of the next frame
+		void WriteDepth(int px, int py, float depth);
+		//Renders one pixel like RenderPixel and stores what it cost in m_PixelCosts
+		void MeasurePixelCost(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material>& materials);
+		//Replaces the rendered colors with the pixel costs, mapped from black over blue, green and yellow to red
+		void WriteCostHeatmap();
 	};
 }
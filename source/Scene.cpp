@@ -1,49 +1,93 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "MeshCache.h"
+#include "Trace.h"
 
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})})
+		m_Materials({ Material::CreateSolidColor({1,0,0}) })
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
-		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
+	Scene::~Scene() = default;
+
+	bool Scene::UpdateAccelerationStructure()
 	{
-		for(auto& pMaterial : m_Materials)
+		TRACE_ZONE("Scene::UpdateAccelerationStructure");
+
+		//Spheres take the first primitive indices, mesh instances follow
+		const size_t nrOfPrimitives{ m_SphereGeometries.size() + m_TriangleMeshInstances.size() };
+		const bool geometryChanged{ m_PrimitiveOrder.size() != nrOfPrimitives || m_BVHSphereCount != m_SphereGeometries.size() };
+
+		m_PrimitiveBounds.resize(nrOfPrimitives);
+		bool geometryMoved{ false };
+		auto updateBounds = [&](size_t primitiveIndex, const Vector3& minAABB, const Vector3& maxAABB)
+			{
+				AABB& bounds{ m_PrimitiveBounds[primitiveIndex] };
+				geometryMoved |= bounds.min.x != minAABB.x || bounds.min.y != minAABB.y || bounds.min.z != minAABB.z ||
+					bounds.max.x != maxAABB.x || bounds.max.y != maxAABB.y || bounds.max.z != maxAABB.z;
+
+				bounds.min = minAABB;
+				bounds.max = maxAABB;
+			};
+
+		for (size_t i{}; i < m_SphereGeometries.size(); ++i)
+		{
+			const Sphere& sphere{ m_SphereGeometries[i] };
+			const Vector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+			updateBounds(i, sphere.origin - radius, sphere.origin + radius);
+		}
+
+		//An instance can turn in place without its bounds changing, it still changes the image
+		bool instanceMoved{ false };
+		for (size_t i{}; i < m_TriangleMeshInstances.size(); ++i)
+		{
+			TriangleMeshInstance& instance{ m_TriangleMeshInstances[i] };
+			updateBounds(m_SphereGeometries.size() + i, instance.transformedMinAABB, instance.transformedMaxAABB);
+
+			instanceMoved |= instance.hasMoved;
+			instance.hasMoved = false;
+		}
+
+		if (geometryChanged)
+		{
+			BuildBVH();
+		}
+		else if (geometryMoved)
 		{
-			delete pMaterial;
-			pMaterial = nullptr;
+			//Keep the topology while things move, rebuild once the tree got too loose
+			if (BVH::Refit(m_PrimitiveBounds, m_PrimitiveOrder, m_BVHNodes) > m_BVHBuildSAHCost * BVH_REFIT_REBUILD_THRESHOLD)
+				BuildBVH();
 		}
 
-		m_Materials.clear();
+		const bool hasChanged{ m_IsDirty || geometryChanged || geometryMoved || instanceMoved };
+		m_IsDirty = false;
+		return hasChanged;
+	}
+
+	void Scene::BuildBVH()
+	{
+		BVH::Build(m_PrimitiveBounds, m_BVHNodes, m_PrimitiveOrder);
+		m_BVHBuildSAHCost = BVH::CalculateStats(m_BVHNodes).sahCost;
+		m_BVHSphereCount = m_SphereGeometries.size();
 	}
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
+		TRACE_ZONE("Scene::GetClosestHit");
+
 		//todo W1
 		//assert(false && "No Implemented Yet!");
 		HitRecord tempHitRecord{};
-		for (const Sphere& sphere : m_SphereGeometries)
-		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, tempHitRecord);
-			if (tempHitRecord.t < closestHit.t)
-			{
-				closestHit.t = tempHitRecord.t;
-				closestHit.didHit = tempHitRecord.didHit;
-				closestHit.materialIndex = tempHitRecord.materialIndex;
-				closestHit.normal = tempHitRecord.normal;
-				closestHit.origin = tempHitRecord.origin;
-			}
-		}
 
+		//Infinite planes can't be bounded, they stay out of the BVH
 		for (const Plane& plane : m_PlaneGeometries)
 		{
 			GeometryUtils::HitTest_Plane(plane, ray, tempHitRecord);
@@ -57,43 +101,152 @@ namespace dae {
 			}
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
-		{
-			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, tempHitRecord);
-			if (tempHitRecord.t < closestHit.t)
+		//The closest plane already limits how far the BVH has to be searched
+		Ray bvhRay{ ray };
+		bvhRay.max = std::min(ray.max, closestHit.t);
+		GeometryUtils::TraverseBVH(m_BVHNodes, bvhRay, [&](const BVHNode& leaf, Ray& leafRay)
 			{
-				closestHit.t = tempHitRecord.t;
-				closestHit.didHit = tempHitRecord.didHit;
-				closestHit.materialIndex = tempHitRecord.materialIndex;
-				closestHit.normal = tempHitRecord.normal;
-				closestHit.origin = tempHitRecord.origin;
-			}
-		}
+				for (uint32_t i{}; i < leaf.primitiveCount; ++i)
+				{
+					const uint32_t primitiveIndex{ m_PrimitiveOrder[leaf.leftFirst + i] };
+					const bool didHit{ primitiveIndex < m_BVHSphereCount ?
+						GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIndex], leafRay, tempHitRecord) :
+						GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshInstances[primitiveIndex - m_BVHSphereCount], leafRay, tempHitRecord) };
+
+					if (didHit && tempHitRecord.t < closestHit.t)
+					{
+						closestHit.t = tempHitRecord.t;
+						closestHit.didHit = tempHitRecord.didHit;
+						closestHit.materialIndex = tempHitRecord.materialIndex;
+						closestHit.normal = tempHitRecord.normal;
+						closestHit.origin = tempHitRecord.origin;
+						leafRay.max = tempHitRecord.t;
+					}
+				}
+				return false;
+			});
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
+		TRACE_ZONE("Scene::DoesHit");
+
 		//todo W3
 		//assert(false && "No Implemented Yet!");
-		
-		for (const Sphere& sphere : m_SphereGeometries)
+
+		for (const Plane& plane : m_PlaneGeometries)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
+			if (GeometryUtils::HitTest_Plane(plane, ray))
 				return true;
 		}
 
+		return GeometryUtils::TraverseBVH_AnyHit(m_BVHNodes, ray, [&](const BVHNode& leaf)
+			{
+				for (uint32_t i{}; i < leaf.primitiveCount; ++i)
+				{
+					const uint32_t primitiveIndex{ m_PrimitiveOrder[leaf.leftFirst + i] };
+					const bool didHit{ primitiveIndex < m_BVHSphereCount ?
+						GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIndex], ray) :
+						GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshInstances[primitiveIndex - m_BVHSphereCount], ray) };
+
+					if (didHit)
+						return true;
+				}
+				return false;
+			});
+	}
+
+	void Scene::GetClosestHit(const RayPacket& packet, HitRecord* closestHits) const
+	{
+		TRACE_ZONE("Scene::GetClosestHit (packet)");
+
+		if (!packet.IsCoherent())
+		{
+			GeometryUtils::ForEachLane(packet.activeMask, [&](uint32_t lane)
+				{
+					GetClosestHit(packet.GetRay(lane), closestHits[lane]);
+				});
+			return;
+		}
+
+		HitRecord tempHitRecords[RAY_PACKET_SIZE]{};
+
 		for (const Plane& plane : m_PlaneGeometries)
 		{
-			if (GeometryUtils::HitTest_Plane(plane, ray))
-				return true;
+			const uint32_t hitMask{ GeometryUtils::HitTest_Plane(plane, packet, packet.activeMask, tempHitRecords) };
+			GeometryUtils::ForEachLane(hitMask, [&](uint32_t lane)
+				{
+					if (tempHitRecords[lane].t < closestHits[lane].t)
+						closestHits[lane] = tempHitRecords[lane];
+				});
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		RayPacket bvhPacket{ packet };
+		GeometryUtils::ForEachLane(packet.activeMask, [&](uint32_t lane)
+			{
+				bvhPacket.max[lane] = std::min(packet.max[lane], closestHits[lane].t);
+			});
+
+		GeometryUtils::TraverseBVH_Packet(m_BVHNodes, bvhPacket, bvhPacket.activeMask, [&](const BVHNode& leaf, RayPacket& leafPacket, uint32_t leafMask)
+			{
+				for (uint32_t i{}; i < leaf.primitiveCount; ++i)
+				{
+					const uint32_t primitiveIndex{ m_PrimitiveOrder[leaf.leftFirst + i] };
+					const uint32_t hitMask{ primitiveIndex < m_BVHSphereCount ?
+						GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIndex], leafPacket, leafMask, tempHitRecords) :
+						GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshInstances[primitiveIndex - m_BVHSphereCount], leafPacket, leafMask, tempHitRecords) };
+
+					GeometryUtils::ForEachLane(hitMask, [&](uint32_t lane)
+						{
+							if (tempHitRecords[lane].t < closestHits[lane].t)
+							{
+								closestHits[lane] = tempHitRecords[lane];
+								leafPacket.max[lane] = tempHitRecords[lane].t;
+							}
+						});
+				}
+				return 0u;
+			});
+	}
+
+	uint32_t Scene::DoesHit(const RayPacket& packet) const
+	{
+		TRACE_ZONE("Scene::DoesHit (packet)");
+
+		uint32_t occludedMask{};
+
+		if (!packet.IsCoherent())
 		{
-			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray))
-				return true;
+			GeometryUtils::ForEachLane(packet.activeMask, [&](uint32_t lane)
+				{
+					if (DoesHit(packet.GetRay(lane)))
+						occludedMask |= 1u << lane;
+				});
+			return occludedMask;
 		}
-		return false;
+
+		for (const Plane& plane : m_PlaneGeometries)
+		{
+			occludedMask |= GeometryUtils::HitTest_Plane(plane, packet, packet.activeMask & ~occludedMask);
+		}
+
+		RayPacket bvhPacket{ packet };
+		return occludedMask | GeometryUtils::TraverseBVH_Packet(m_BVHNodes, bvhPacket, packet.activeMask & ~occludedMask,
+			[&](const BVHNode& leaf, RayPacket& leafPacket, uint32_t leafMask)
+			{
+				uint32_t leafOccludedMask{};
+				for (uint32_t i{}; i < leaf.primitiveCount && leafMask != 0; ++i)
+				{
+					const uint32_t primitiveIndex{ m_PrimitiveOrder[leaf.leftFirst + i] };
+					const uint32_t hitMask{ primitiveIndex < m_BVHSphereCount ?
+						GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitiveIndex], leafPacket, leafMask) :
+						GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshInstances[primitiveIndex - m_BVHSphereCount], leafPacket, leafMask) };
+
+					leafOccludedMask |= hitMask;
+					leafMask &= ~hitMask;
+				}
+				return leafOccludedMask;
+			});
 	}
 
 #pragma region Scene Helpers
@@ -105,6 +258,7 @@ namespace dae {
 		s.materialIndex = materialIndex;
 
 		m_SphereGeometries.emplace_back(s);
+		m_IsDirty = true;
 		return &m_SphereGeometries.back();
 	}
 
@@ -116,17 +270,27 @@ namespace dae {
 		p.materialIndex = materialIndex;
 
 		m_PlaneGeometries.emplace_back(p);
+		m_IsDirty = true;
 		return &m_PlaneGeometries.back();
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMesh* Scene::AddTriangleMesh()
+	{
+		m_TriangleMeshGeometries.emplace_back();
+		m_IsDirty = true;
+		return &m_TriangleMeshGeometries.back();
+	}
+
+	TriangleMeshInstance* Scene::AddTriangleMeshInstance(const TriangleMesh* pMesh, TriangleCullMode cullMode, unsigned char materialIndex)
 	{
-		TriangleMesh m{};
+		TriangleMeshInstance m{};
+		m.pMesh = pMesh;
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
-		m_TriangleMeshGeometries.emplace_back(m);
-		return &m_TriangleMeshGeometries.back();
+		m_TriangleMeshInstances.emplace_back(m);
+		m_IsDirty = true;
+		return &m_TriangleMeshInstances.back();
 	}
 
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
@@ -138,6 +302,7 @@ namespace dae {
 		l.type = LightType::Point;
 
 		m_Lights.emplace_back(l);
+		m_IsDirty = true;
 		return &m_Lights.back();
 	}
 
@@ -150,12 +315,14 @@ namespace dae {
 		l.type = LightType::Directional;
 
 		m_Lights.emplace_back(l);
+		m_IsDirty = true;
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	unsigned char Scene::AddMaterial(const Material& material)
 	{
-		m_Materials.push_back(pMaterial);
+		m_Materials.push_back(material);
+		m_IsDirty = true;
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
 #pragma endregion
@@ -166,11 +333,11 @@ namespace dae {
 	{
 				//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material::CreateSolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material::CreateSolidColor(colors::Yellow));
+		const unsigned char matId_Solid_Green = AddMaterial(Material::CreateSolidColor(colors::Green));
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material::CreateSolidColor(colors::Magenta));
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -193,11 +360,11 @@ namespace dae {
 
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material::CreateSolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material::CreateSolidColor(colors::Yellow));
+		const unsigned char matId_Solid_Green = AddMaterial(Material::CreateSolidColor(colors::Green));
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material::CreateSolidColor(colors::Magenta));
 
 		//Plane
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f,0.f }, matId_Solid_Green);
@@ -224,15 +391,15 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//gray materials CookTorrence
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
 
 		//blue material Lambert
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ 0.49f, 0.57f, 0.57f }, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //Back
@@ -261,11 +428,11 @@ namespace dae {
 		m_Camera.origin = { 0.f,1.f,-5.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matLambert_Red = AddMaterial(new Material_Lambert(colors::Red, 1.f));
-		const auto matLambert_Blue = AddMaterial(new Material_Lambert(colors::Blue, 1.f));
-		const auto matLambert_Yellow = AddMaterial(new Material_Lambert(colors::Yellow, 1.f));
+		const auto matLambert_Red = AddMaterial(Material::CreateLambert(colors::Red, 1.f));
+		const auto matLambert_Blue = AddMaterial(Material::CreateLambert(colors::Blue, 1.f));
+		const auto matLambert_Yellow = AddMaterial(Material::CreateLambert(colors::Yellow, 1.f));
 
-		const auto matPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.f));
+		const auto matPhong_Blue = AddMaterial(Material::CreateLambertPhong(colors::Blue, 1.f, 1.f, 60.f));
 		
 
 		AddSphere({ -0.75f, 1.0f, 0.0f }, 1.0f, matLambert_Red);
@@ -284,8 +451,8 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57 }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ 0.49f, 0.57f, 0.57 }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f,0.f,10.f }, Vector3{ 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
@@ -309,12 +476,10 @@ namespace dae {
 			0,2,3
 		};*/
 
-		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/simple_cube.obj",
-			pMesh->positions,
-			pMesh->normals,
-			pMesh->indices);
+		TriangleMesh* pCubeMesh = AddTriangleMesh();
+		MeshCache::LoadOBJ("Resources/simple_cube.obj", *pCubeMesh);
 
+		pMesh = AddTriangleMeshInstance(pCubeMesh, TriangleCullMode::BackFaceCulling, matLambert_White);
 		pMesh->Scale({ 0.7f, 0.7f, 0.7f });
 		pMesh->Translate({ 0.0f, 1.0f, 0.0f });
 		//pMesh->RotateY(45);
@@ -341,16 +506,16 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//gray materials CookTorrence
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CreateCookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CreateCookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
 
 		//blue material Lambert
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f,0.f,10.f }, Vector3{ 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
@@ -371,23 +536,20 @@ namespace dae {
 		//In clock wise order
 		const Triangle baseTriangle = { Vector3{-0.75f, 1.5f, 0.0f}, Vector3{0.75f, 0.0f, 0.0f}, Vector3{-0.75f, 0.0f, 0.0f} };
 
-		m_pMeshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_pMeshes[0]->AppendTriangle(baseTriangle, true);
+		//All three instances share the same triangle, only the culling differs
+		TriangleMesh* pTriangleMesh = AddTriangleMesh();
+		pTriangleMesh->AppendTriangle(baseTriangle);
+
+		m_pMeshes[0] = AddTriangleMeshInstance(pTriangleMesh, TriangleCullMode::BackFaceCulling, matLambert_White);
 		m_pMeshes[0]->Translate({ -1.75f, 4.5f, 0.0f });
-		m_pMeshes[0]->UpdateAABB();
 		m_pMeshes[0]->UpdateTransforms();
 
-
-		m_pMeshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_pMeshes[1]->AppendTriangle(baseTriangle, true);
+		m_pMeshes[1] = AddTriangleMeshInstance(pTriangleMesh, TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_pMeshes[1]->Translate({ 0.0f, 4.5f, 0.0f });
-		m_pMeshes[1]->UpdateAABB();
 		m_pMeshes[1]->UpdateTransforms();
 
-		m_pMeshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_pMeshes[2]->AppendTriangle(baseTriangle, true);
+		m_pMeshes[2] = AddTriangleMeshInstance(pTriangleMesh, TriangleCullMode::NoCulling, matLambert_White);
 		m_pMeshes[2]->Translate({ 1.75f, 4.5f, 0.0f });
-		m_pMeshes[2]->UpdateAABB();
 		m_pMeshes[2]->UpdateTransforms();
 
 		//Lights
@@ -414,8 +576,8 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57 }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::Gray, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ 0.49f, 0.57f, 0.57 }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::Gray, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f,0.f,10.f }, Vector3{ 0.f,0.f,-1.f }, matLambert_GrayBlue); //Back
@@ -424,15 +586,11 @@ namespace dae {
 		AddPlane(Vector3{ 5.f,0.f,0.f }, Vector3{ -1.f,0.f,0.f }, matLambert_GrayBlue); //Right
 		AddPlane(Vector3{ -5.f,0.f,0.f }, Vector3{ 1.f,0.f,0.f }, matLambert_GrayBlue); //Left
 
-		m_pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj",
-			m_pMesh->positions,
-			m_pMesh->normals,
-			m_pMesh->indices);
+		TriangleMesh* pBunnyMesh = AddTriangleMesh();
+		MeshCache::LoadOBJ("Resources/lowpoly_bunny2.obj", *pBunnyMesh);
 
+		m_pMesh = AddTriangleMeshInstance(pBunnyMesh, TriangleCullMode::BackFaceCulling, matLambert_White);
 		m_pMesh->Scale({ 2.0f, 2.0f, 2.0f });
-
-		m_pMesh->UpdateAABB();
 		m_pMesh->UpdateTransforms();
 
 		//Light
@@ -448,4 +606,43 @@ namespace dae {
 		m_pMesh->RotateY(yawAngle);
 		m_pMesh->UpdateTransforms();
 	}
+
+#pragma region Scene Factory
+	namespace
+	{
+		using SceneFactory = Scene* (*)();
+
+		//Every built-in scene, in the order they were written
+		const std::pair<std::string, SceneFactory> g_SceneFactories[]
+		{
+			{ "Scene_W1", [] () -> Scene* { return new Scene_W1(); } },
+			{ "Scene_W2", [] () -> Scene* { return new Scene_W2(); } },
+			{ "Scene_W3", [] () -> Scene* { return new Scene_W3(); } },
+			{ "Scene_W3_TestScene", [] () -> Scene* { return new Scene_W3_TestScene(); } },
+			{ "Scene_W4_TestScene", [] () -> Scene* { return new Scene_W4_TestScene(); } },
+			{ "Scene_W4_ReferenceScene", [] () -> Scene* { return new Scene_W4_ReferenceScene(); } },
+			{ "Scene_W4_BunnyScene", [] () -> Scene* { return new Scene_W4_BunnyScene(); } }
+		};
+	}
+
+	std::vector<std::string> GetSceneNames()
+	{
+		std::vector<std::string> sceneNames{};
+		for (const auto& [name, createFunction] : g_SceneFactories)
+		{
+			sceneNames.push_back(name);
+		}
+		return sceneNames;
+	}
+
+	Scene* CreateScene(const std::string& sceneName)
+	{
+		for (const auto& [name, createFunction] : g_SceneFactories)
+		{
+			if (sceneName == name)
+				return createFunction();
+		}
+		return nullptr;
+	}
+#pragma endregion
 }
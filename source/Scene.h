@@ -1,16 +1,17 @@
 #pragma once
+#include <deque>
 #include <string>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "Material.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
@@ -34,31 +35,58 @@ namespace dae
 		}
 
 		Camera& GetCamera() { return m_Camera; }
+		//Refits the scene BVH when spheres or instances moved, rebuilds it when geometry was added or removed.
+		//Returns false when nothing that shows up in the image changed since the last call
+		bool UpdateAccelerationStructure();
+		//For changes the scene can't detect itself, e.g. edited lights, materials or mesh geometry
+		void MarkDirty() { m_IsDirty = true; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
+		//Packet versions, incoherent packets fall back to one ray at a time
+		//closestHits holds one record per lane, only the active lanes are written
+		void GetClosestHit(const RayPacket& packet, HitRecord* closestHits) const;
+		//Returns the active lanes that are blocked
+		uint32_t DoesHit(const RayPacket& packet) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
 
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
-		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		//Deques so instances can keep pointing to their mesh, and scenes to their instances, while more get added
+		std::deque<TriangleMesh> m_TriangleMeshGeometries{};
+		std::deque<TriangleMeshInstance> m_TriangleMeshInstances{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		std::vector<Material> m_Materials{};
 		Camera m_Camera{};
 
+		//Scene BVH over all bounded geometry, primitive indices below m_BVHSphereCount are spheres,
+		//the rest are mesh instances. Planes are infinite and stay in their own list
+		std::vector<BVHNode> m_BVHNodes{};
+		std::vector<uint32_t> m_PrimitiveOrder{};
+		std::vector<AABB> m_PrimitiveBounds{};
+		size_t m_BVHSphereCount{};
+		float m_BVHBuildSAHCost{};
+
+		//Something was added or marked dirty since the last UpdateAccelerationStructure
+		bool m_IsDirty{ true };
+
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		TriangleMesh* AddTriangleMesh();
+		TriangleMeshInstance* AddTriangleMeshInstance(const TriangleMesh* pMesh, TriangleCullMode cullMode, unsigned char materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		unsigned char AddMaterial(const Material& material);
+
+	private:
+		void BuildBVH();
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -134,7 +162,7 @@ namespace dae
 		void Update(Timer* pTimer) override;
 
 	private:
-		TriangleMesh* pMesh{ nullptr };
+		TriangleMeshInstance* pMesh{ nullptr };
 	};
 
 	class Scene_W4_ReferenceScene final : public Scene
@@ -152,7 +180,7 @@ namespace dae
 		void Update(Timer* pTimer) override;
 
 	private:
-		TriangleMesh* m_pMeshes[3]{};
+		TriangleMeshInstance* m_pMeshes[3]{};
 	};
 
 	class Scene_W4_BunnyScene final : public Scene
@@ -170,6 +198,11 @@ namespace dae
 		void Update(Timer* pTimer) override;
 
 	private:
-		TriangleMesh* m_pMesh{};
+		TriangleMeshInstance* m_pMesh{};
 	};
+
+	//Class names of the built-in scenes, in the order they were written
+	std::vector<std::string> GetSceneNames();
+	//Allocates the built-in scene with the given class name, nullptr when there is none
+	Scene* CreateScene(const std::string& sceneName);
 }
@@ -0,0 +1,183 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		uint64_t PackRange(uint32_t begin, uint32_t end)
+		{
+			return (static_cast<uint64_t>(end) << 32) | begin;
+		}
+
+		uint32_t RangeBegin(uint64_t range)
+		{
+			return static_cast<uint32_t>(range);
+		}
+
+		uint32_t RangeEnd(uint64_t range)
+		{
+			return static_cast<uint32_t>(range >> 32);
+		}
+
+		void PinThread(std::thread& thread, uint32_t core)
+		{
+#if defined(_WIN32)
+			SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(core % CPU_SETSIZE, &cpuSet);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+			(void)thread;
+			(void)core;
+#endif
+		}
+	}
+
+	ThreadPool::ThreadPool(uint32_t threadCount, ThreadPinning pinning) :
+		m_Queues(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+	{
+		//Queue 0 belongs to the thread calling ParallelFor
+		const uint32_t queueCount{ GetThreadCount() };
+		m_Threads.reserve(queueCount - 1);
+		for (uint32_t workerIndex{ 1 }; workerIndex < queueCount; ++workerIndex)
+		{
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, workerIndex);
+
+			if (pinning == ThreadPinning::Compact)
+				PinThread(m_Threads.back(), workerIndex);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsShuttingDown = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+	{
+		if (taskCount == 0)
+			return;
+
+		//Equal contiguous shares, stealing evens out shares that turn out to be more expensive
+		const uint32_t queueCount{ GetThreadCount() };
+		for (uint32_t queueIndex{}; queueIndex < queueCount; ++queueIndex)
+		{
+			const uint32_t begin{ static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * queueIndex / queueCount) };
+			const uint32_t end{ static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * (queueIndex + 1) / queueCount) };
+			m_Queues[queueIndex].range.store(PackRange(begin, end));
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pTask = &task;
+			m_BusyWorkers = queueCount - 1;
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunTasks(0);
+
+		//Workers still finishing their last task keep using task, wait for all of them
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_BusyWorkers == 0; });
+		m_pTask = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t workerIndex)
+	{
+		Trace::SetThreadName("Worker " + std::to_string(workerIndex));
+
+		uint64_t seenGeneration{};
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [&] { return m_IsShuttingDown || m_Generation != seenGeneration; });
+				if (m_IsShuttingDown)
+					return;
+
+				seenGeneration = m_Generation;
+			}
+
+			RunTasks(workerIndex);
+
+			std::lock_guard lock{ m_Mutex };
+			if (--m_BusyWorkers == 0)
+				m_DoneCondition.notify_one();
+		}
+	}
+
+	void ThreadPool::RunTasks(uint32_t workerIndex)
+	{
+		uint32_t taskIndex{};
+		while (true)
+		{
+			if (PopTask(workerIndex, taskIndex))
+				(*m_pTask)(taskIndex);
+			else if (!StealTasks(workerIndex))
+				return;
+		}
+	}
+
+	bool ThreadPool::PopTask(uint32_t workerIndex, uint32_t& taskIndex)
+	{
+		std::atomic<uint64_t>& range{ m_Queues[workerIndex].range };
+		uint64_t current{ range.load() };
+		while (RangeBegin(current) < RangeEnd(current))
+		{
+			if (range.compare_exchange_weak(current, PackRange(RangeBegin(current) + 1, RangeEnd(current))))
+			{
+				taskIndex = RangeBegin(current);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ThreadPool::StealTasks(uint32_t workerIndex)
+	{
+		//Only called with an empty own queue, so no thief competes for it while it gets refilled
+		const uint32_t queueCount{ GetThreadCount() };
+		for (uint32_t offset{ 1 }; offset < queueCount; ++offset)
+		{
+			std::atomic<uint64_t>& victimRange{ m_Queues[(workerIndex + offset) % queueCount].range };
+			uint64_t current{ victimRange.load() };
+			while (RangeBegin(current) < RangeEnd(current))
+			{
+				//Take the back half, rounded up so a single remaining task can be stolen too
+				const uint32_t begin{ RangeBegin(current) };
+				const uint32_t end{ RangeEnd(current) };
+				const uint32_t newEnd{ end - (end - begin + 1) / 2 };
+				if (victimRange.compare_exchange_weak(current, PackRange(begin, newEnd)))
+				{
+					m_Queues[workerIndex].range.store(PackRange(newEnd, end));
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class ThreadPinning
+	{
+		None, //Let the OS schedule the workers
+		Compact //Worker i runs on logical core i, the calling thread is left alone
+	};
+
+	//Persistent workers that run ParallelFor jobs, tasks are spread over per-worker queues and idle workers steal from busy ones
+	class ThreadPool final
+	{
+	public:
+		//threadCount 0 uses every hardware thread, the thread calling ParallelFor counts as one of them
+		ThreadPool(uint32_t threadCount = 0, ThreadPinning pinning = ThreadPinning::None);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		/**
+		 * \brief Runs task(taskIndex) for every index in [0, taskCount), the calling thread helps and returns once all tasks are done
+		 * \param taskCount number of tasks, every worker starts with an equal contiguous share
+		 * \param task called once per index from any worker
+		 */
+		void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	private:
+		//Range of task indices [begin, end) packed in one atomic, the owner pops from the front and thieves take the back half
+		struct alignas(64) TaskQueue
+		{
+			std::atomic<uint64_t> range{};
+		};
+
+		std::vector<TaskQueue> m_Queues;
+		std::vector<std::thread> m_Threads{};
+
+		const std::function<void(uint32_t)>* m_pTask{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+		uint64_t m_Generation{};
+		uint32_t m_BusyWorkers{};
+		bool m_IsShuttingDown{};
+
+		void WorkerLoop(uint32_t workerIndex);
+		void RunTasks(uint32_t workerIndex);
+		bool PopTask(uint32_t workerIndex, uint32_t& taskIndex);
+		bool StealTasks(uint32_t workerIndex);
+	};
+}
@@ -1,11 +1,5 @@
 #include "Timer.h"
 
-#include <iostream>
-#include <numeric>
-
-#include <iostream>
-#include <fstream>
-
 #include "SDL.h"
 using namespace dae;
 
@@ -41,29 +35,6 @@ void Timer::Start()
 	}
 }
 
-void Timer::StartBenchmark(int numFrames)
-{
-	if (m_BenchmarkActive)
-	{
-		std::cout << "(Benchmark already running)";
-		return;
-	}
-
-	m_BenchmarkActive = true;
-
-	m_BenchmarkAvg = 0.f;
-	m_BenchmarkHigh = FLT_MIN;
-	m_BenchmarkLow = FLT_MAX;
-
-	m_BenchmarkFrames = numFrames;
-	m_BenchmarkCurrFrame = 0;
-
-	m_Benchmarks.clear();
-	m_Benchmarks.resize(m_BenchmarkFrames);
-
-	std::cout<< "**BENCHMARK STARTED**\n";
-}
-
 void Timer::Update()
 {
 	if (m_IsStopped)
@@ -99,35 +70,6 @@ void Timer::Update()
 		m_FPS = m_FPSCount;
 		m_FPSCount = 0;
 		m_FPSTimer = 0.0f;
-
-		if (m_BenchmarkActive)
-		{
-			m_Benchmarks[m_BenchmarkCurrFrame] = m_dFPS;
-
-			m_BenchmarkLow = std::min(m_BenchmarkLow, m_dFPS);
-			m_BenchmarkHigh = std::max(m_BenchmarkHigh, m_dFPS);
-
-			++m_BenchmarkCurrFrame;
-			if(m_BenchmarkCurrFrame >= m_BenchmarkFrames)
-			{
-				m_BenchmarkActive = false;
-				m_BenchmarkAvg = std::accumulate(m_Benchmarks.begin(), m_Benchmarks.end(), 0.f) / float(m_BenchmarkFrames);
-
-				//print
-				std::cout << "**BENCHMARK FINISHED**\n";
-				std::cout << ">> HIGH = " << m_BenchmarkHigh << std::endl;
-				std::cout << ">> LOW = " << m_BenchmarkLow << std::endl;
-				std::cout << ">> AVG = " << m_BenchmarkAvg << std::endl;
-
-				//file save
-				std::ofstream fileStream("benchmark.txt");
-				fileStream << "FRAMES = " << m_BenchmarkCurrFrame << std::endl;
-				fileStream << "HIGH = " << m_BenchmarkHigh << std::endl;
-				fileStream << "LOW = " << m_BenchmarkLow << std::endl;
-				fileStream << "AVG = " << m_BenchmarkAvg << std::endl;
-				fileStream.close();
-			}
-		}
 	}
 }
 
@@ -141,3 +83,12 @@ void Timer::Stop()
 		m_IsStopped = true;
 	}
 }
+
+void Timer::Freeze(float totalTime)
+{
+	Stop();
+
+	m_FPS = 0;
+	m_ElapsedTime = 0.0f;
+	m_TotalTime = totalTime;
+}
@@ -2,7 +2,6 @@
 
 //Standard includes
 #include <cstdint>
-#include <vector>
 
 namespace dae
 {
@@ -17,12 +16,12 @@ namespace dae
 		Timer& operator=(const Timer&) = delete;
 		Timer& operator=(Timer&&) noexcept = delete;
 
-		void StartBenchmark(int numFrames = 10);
-
 		void Reset();
 		void Start();
 		void Update();
 		void Stop();
+		//Stops the timer at totalTime with no elapsed time, so scenes animate to the same pose every update
+		void Freeze(float totalTime);
 
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
@@ -49,13 +48,5 @@ namespace dae
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
-
-		bool m_BenchmarkActive = false;
-		float m_BenchmarkHigh{ 0.f };
-		float m_BenchmarkLow{ 0.f };
-		float m_BenchmarkAvg{ 0.f };
-		int m_BenchmarkFrames{ 0 };
-		int m_BenchmarkCurrFrame{ 0 };
-		std::vector<float> m_Benchmarks{};
 	};
 }
@@ -0,0 +1,178 @@
+#include "Trace.h"
+
+//Standard includes
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		struct TraceEvent
+		{
+			const char* name;
+			uint64_t startTime;
+			uint64_t endTime;
+		};
+
+		//Only the owning thread writes its events, so recording never takes a lock
+		struct ThreadTrace
+		{
+			uint32_t threadId{};
+			std::string threadName{};
+
+			std::unique_ptr<TraceEvent[]> pEvents{};
+			uint32_t capacity{};
+			uint32_t eventCount{};
+			uint64_t droppedEventCount{};
+			//Capture the events belong to, older events are cleared on the first zone of a new capture
+			uint32_t captureIndex{};
+		};
+
+		//Threads register once, their traces stay alive so they can still be written after the thread exited
+		std::mutex g_ThreadTracesMutex{};
+		std::vector<std::unique_ptr<ThreadTrace>> g_ThreadTraces{};
+
+		std::atomic<uint32_t> g_CaptureIndex{};
+		std::atomic<uint32_t> g_MaxEventsPerThread{};
+		uint64_t g_CaptureStartTime{};
+
+		ThreadTrace& GetThreadTrace()
+		{
+			thread_local ThreadTrace* pThreadTrace{};
+			if (!pThreadTrace)
+			{
+				std::lock_guard lock{ g_ThreadTracesMutex };
+				g_ThreadTraces.push_back(std::make_unique<ThreadTrace>());
+				pThreadTrace = g_ThreadTraces.back().get();
+				pThreadTrace->threadId = static_cast<uint32_t>(g_ThreadTraces.size());
+			}
+			return *pThreadTrace;
+		}
+
+		//Names are written as is, escape the characters that would break the JSON
+		void WriteJSONString(std::ofstream& fileStream, const char* text)
+		{
+			fileStream << '"';
+			for (const char* pCharacter{ text }; *pCharacter; ++pCharacter)
+			{
+				if (*pCharacter == '"' || *pCharacter == '\\')
+					fileStream << '\\';
+				fileStream << *pCharacter;
+			}
+			fileStream << '"';
+		}
+	}
+
+	void Trace::Start(uint32_t maxEventsPerThread)
+	{
+		g_MaxEventsPerThread.store(maxEventsPerThread);
+		g_CaptureIndex.fetch_add(1);
+		g_CaptureStartTime = GetTimestamp();
+		g_IsRecording.store(true);
+	}
+
+	void Trace::Stop()
+	{
+		g_IsRecording.store(false);
+	}
+
+	bool Trace::WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream fileStream{ path };
+		if (!fileStream)
+			return false;
+
+		std::lock_guard lock{ g_ThreadTracesMutex };
+		const uint32_t captureIndex{ g_CaptureIndex.load() };
+
+		//Complete events with microsecond timestamps relative to the start of the capture
+		fileStream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool isFirstEvent{ true };
+		auto writeSeparator = [&]
+			{
+				fileStream << (isFirstEvent ? "\n" : ",\n");
+				isFirstEvent = false;
+			};
+
+		for (const std::unique_ptr<ThreadTrace>& pThreadTrace : g_ThreadTraces)
+		{
+			if (pThreadTrace->captureIndex != captureIndex)
+				continue;
+
+			if (!pThreadTrace->threadName.empty())
+			{
+				writeSeparator();
+				fileStream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pThreadTrace->threadId << ",\"args\":{\"name\":";
+				WriteJSONString(fileStream, pThreadTrace->threadName.c_str());
+				fileStream << "}}";
+			}
+
+			for (uint32_t eventIndex{}; eventIndex < pThreadTrace->eventCount; ++eventIndex)
+			{
+				//Zones that were already open when the capture started
+				const TraceEvent& event{ pThreadTrace->pEvents[eventIndex] };
+				if (event.startTime < g_CaptureStartTime)
+					continue;
+
+				writeSeparator();
+				fileStream << "{\"name\":";
+				WriteJSONString(fileStream, event.name);
+				fileStream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << pThreadTrace->threadId
+					<< ",\"ts\":" << (event.startTime - g_CaptureStartTime) / 1000.0
+					<< ",\"dur\":" << (event.endTime - event.startTime) / 1000.0 << "}";
+			}
+
+			if (pThreadTrace->droppedEventCount > 0)
+			{
+				writeSeparator();
+				fileStream << "{\"name\":\"dropped zones\",\"ph\":\"C\",\"pid\":1,\"tid\":" << pThreadTrace->threadId
+					<< ",\"ts\":0,\"args\":{\"thread " << pThreadTrace->threadId << "\":" << pThreadTrace->droppedEventCount << "}}";
+			}
+		}
+		fileStream << "\n]}\n";
+
+		return fileStream.good();
+	}
+
+	void Trace::SetThreadName(const std::string& name)
+	{
+		GetThreadTrace().threadName = name;
+	}
+
+	uint64_t Trace::GetTimestamp()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void Trace::RecordZone(const char* name, uint64_t startTime, uint64_t endTime)
+	{
+		ThreadTrace& threadTrace{ GetThreadTrace() };
+
+		const uint32_t captureIndex{ g_CaptureIndex.load(std::memory_order_relaxed) };
+		if (threadTrace.captureIndex != captureIndex)
+		{
+			const uint32_t maxEventCount{ g_MaxEventsPerThread.load(std::memory_order_relaxed) };
+			if (threadTrace.capacity != maxEventCount)
+			{
+				//Left uninitialized, only the pages that get written are ever touched
+				threadTrace.pEvents.reset(new TraceEvent[maxEventCount]);
+				threadTrace.capacity = maxEventCount;
+			}
+			threadTrace.eventCount = 0;
+			threadTrace.droppedEventCount = 0;
+			threadTrace.captureIndex = captureIndex;
+		}
+
+		if (threadTrace.eventCount == threadTrace.capacity)
+		{
+			++threadTrace.droppedEventCount;
+			return;
+		}
+
+		threadTrace.pEvents[threadTrace.eventCount++] = { name, startTime, endTime };
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//Scoped timing zones recorded per thread and written as a Chrome trace, open the file in chrome://tracing or ui.perfetto.dev
+	namespace Trace
+	{
+		//Checked by every zone, a disabled zone costs one relaxed load
+		inline std::atomic<bool> g_IsRecording{ false };
+
+		inline bool IsRecording() { return g_IsRecording.load(std::memory_order_relaxed); }
+
+		/**
+		 * \brief Starts a new capture, zones of an earlier capture are thrown away
+		 * \param maxEventsPerThread zones a thread records before it starts dropping them, every zone takes 24 bytes
+		 */
+		void Start(uint32_t maxEventsPerThread = 1 << 20);
+		void Stop();
+		//Call after Stop, while no zones are being recorded. Returns false when the file couldn't be written
+		bool WriteChromeTrace(const std::string& path);
+
+		//Name of the calling thread in the trace
+		void SetThreadName(const std::string& name);
+
+		uint64_t GetTimestamp();
+		void RecordZone(const char* name, uint64_t startTime, uint64_t endTime);
+	}
+
+	//Records the time between construction and destruction when a capture is running
+	class TraceZone final
+	{
+	public:
+		explicit TraceZone(const char* name) :
+			m_Name(name),
+			m_StartTime(Trace::IsRecording() ? Trace::GetTimestamp() : 0)
+		{
+		}
+		~TraceZone()
+		{
+			if (m_StartTime != 0)
+				Trace::RecordZone(m_Name, m_StartTime, Trace::GetTimestamp());
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone(TraceZone&&) noexcept = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+		TraceZone& operator=(TraceZone&&) noexcept = delete;
+
+	private:
+		const char* m_Name;
+		uint64_t m_StartTime;
+	};
+}
+
+//Zone covering the rest of the enclosing scope, name has to be a string literal
+//Define DISABLE_TRACE_ZONES to compile every zone out
+#if defined(DISABLE_TRACE_ZONES)
+#define TRACE_ZONE(name)
+#else
+#define TRACE_ZONE_CONCAT_INNER(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) dae::TraceZone TRACE_ZONE_CONCAT(traceZone, __LINE__){ name }
+#endif
@@ -0,0 +1,370 @@
+#include "TriangleKernels.h"
+
+#include <bit>
+#include <cfloat>
+#include <limits>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "Utils.h"
+
+//MSVC emits any intrinsic it is given, gcc/clang have to be told per function which extensions they may use
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE4
+#define TARGET_AVX2
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		using HitTestFunction = bool(*)(const TriangleBlock&, uint32_t, TriangleCullMode, const Ray&, HitRecord&);
+		using DoesHitFunction = bool(*)(const TriangleBlock&, uint32_t, TriangleCullMode, const Ray&);
+
+		//Culling folded into two bit masks: a lane survives when ((facing & absMask) ^ flipMask) > 0,
+		//where facing has the sign of dot(normal, direction)
+		struct CullMasks
+		{
+			int absMask;
+			int flipMask;
+		};
+
+		CullMasks GetCullMasks(TriangleCullMode cullMode)
+		{
+			switch (cullMode)
+			{
+			case TriangleCullMode::FrontFaceCulling:
+				return { ~0, 0 }; //keep facing > 0
+			case TriangleCullMode::BackFaceCulling:
+				return { ~0, static_cast<int>(0x80000000) }; //keep facing < 0
+			default:
+				return { 0x7FFFFFFF, 0 }; //keep facing != 0
+			}
+		}
+
+#pragma region Scalar
+		bool HitTest_Scalar(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord)
+		{
+			Ray laneRay{ ray };
+			bool didHit{};
+			for (uint32_t lane{}; lane < triangleCount; ++lane)
+			{
+				if (GeometryUtils::HitTest_Triangle(block.GetTriangle(lane), cullMode, laneRay, hitRecord))
+				{
+					laneRay.max = hitRecord.t;
+					didHit = true;
+				}
+			}
+			return didHit;
+		}
+
+		bool DoesHit_Scalar(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray)
+		{
+			for (uint32_t lane{}; lane < triangleCount; ++lane)
+			{
+				if (GeometryUtils::DoesHit_Triangle(block.GetTriangle(lane), cullMode, ray))
+					return true;
+			}
+			return false;
+		}
+#pragma endregion
+
+#pragma region SSE4
+		//Moller-Trumbore on 4 lanes, returns t with every rejected lane set to infinity
+		TARGET_SSE4 __m128 Intersect_SSE4(const TriangleBlock& block, uint32_t offset, const CullMasks& cullMasks, bool cullOnNormal, const Ray& ray)
+		{
+			const __m128 dirX{ _mm_set1_ps(ray.direction.x) };
+			const __m128 dirY{ _mm_set1_ps(ray.direction.y) };
+			const __m128 dirZ{ _mm_set1_ps(ray.direction.z) };
+
+			const __m128 edge1X{ _mm_load_ps(block.edge1X + offset) };
+			const __m128 edge1Y{ _mm_load_ps(block.edge1Y + offset) };
+			const __m128 edge1Z{ _mm_load_ps(block.edge1Z + offset) };
+			const __m128 edge2X{ _mm_load_ps(block.edge2X + offset) };
+			const __m128 edge2Y{ _mm_load_ps(block.edge2Y + offset) };
+			const __m128 edge2Z{ _mm_load_ps(block.edge2Z + offset) };
+
+			//perVec = cross(direction, edge2)
+			const __m128 perX{ _mm_sub_ps(_mm_mul_ps(dirY, edge2Z), _mm_mul_ps(edge2Y, dirZ)) };
+			const __m128 perY{ _mm_sub_ps(_mm_mul_ps(dirZ, edge2X), _mm_mul_ps(edge2Z, dirX)) };
+			const __m128 perZ{ _mm_sub_ps(_mm_mul_ps(dirX, edge2Y), _mm_mul_ps(edge2X, dirY)) };
+			const __m128 det{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, perX), _mm_mul_ps(edge1Y, perY)), _mm_mul_ps(edge1Z, perZ)) };
+
+			//The closest hit culls on the stored normal like the scalar test, occlusion on the determinant which has the opposite sign
+			__m128 facing{};
+			if (cullOnNormal)
+				facing = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(block.normalX + offset), dirX),
+					_mm_mul_ps(_mm_load_ps(block.normalY + offset), dirY)), _mm_mul_ps(_mm_load_ps(block.normalZ + offset), dirZ));
+			else
+				facing = _mm_xor_ps(det, _mm_set1_ps(-0.f));
+
+			const __m128 culled{ _mm_xor_ps(_mm_and_ps(facing, _mm_castsi128_ps(_mm_set1_epi32(cullMasks.absMask))),
+				_mm_castsi128_ps(_mm_set1_epi32(cullMasks.flipMask))) };
+			__m128 hitMask{ _mm_cmpgt_ps(culled, _mm_setzero_ps()) };
+
+			//A zero determinant gives an infinite or NaN u, both fail the range tests below
+			const __m128 invDet{ _mm_div_ps(_mm_set1_ps(1.f), det) };
+
+			const __m128 tVecX{ _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(block.v0X + offset)) };
+			const __m128 tVecY{ _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(block.v0Y + offset)) };
+			const __m128 tVecZ{ _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(block.v0Z + offset)) };
+			const __m128 u{ _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(tVecX, perX), _mm_mul_ps(tVecY, perY)), _mm_mul_ps(tVecZ, perZ))) };
+
+			//qVec = cross(tVec, edge1)
+			const __m128 qX{ _mm_sub_ps(_mm_mul_ps(tVecY, edge1Z), _mm_mul_ps(edge1Y, tVecZ)) };
+			const __m128 qY{ _mm_sub_ps(_mm_mul_ps(tVecZ, edge1X), _mm_mul_ps(edge1Z, tVecX)) };
+			const __m128 qZ{ _mm_sub_ps(_mm_mul_ps(tVecX, edge1Y), _mm_mul_ps(edge1X, tVecY)) };
+			const __m128 v{ _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, qX), _mm_mul_ps(dirY, qY)), _mm_mul_ps(dirZ, qZ))) };
+			const __m128 t{ _mm_mul_ps(invDet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ))) };
+
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+			hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+			hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpge_ps(t, _mm_set1_ps(ray.min)), _mm_cmple_ps(t, _mm_set1_ps(ray.max))));
+			hitMask = _mm_and_ps(hitMask, _mm_cmpgt_ps(t, zero));
+
+			return _mm_blendv_ps(_mm_set1_ps(std::numeric_limits<float>::infinity()), t, hitMask);
+		}
+
+		TARGET_SSE4 bool HitTest_SSE4(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord)
+		{
+			const CullMasks cullMasks{ GetCullMasks(cullMode) };
+
+			const __m128 lowT{ Intersect_SSE4(block, 0, cullMasks, true, ray) };
+			__m128 highT{ _mm_set1_ps(std::numeric_limits<float>::infinity()) };
+			if (triangleCount > 4)
+				highT = Intersect_SSE4(block, 4, cullMasks, true, ray);
+
+			//Horizontal min, every lane ends up holding the nearest t
+			__m128 minT{ _mm_min_ps(lowT, highT) };
+			minT = _mm_min_ps(minT, _mm_shuffle_ps(minT, minT, _MM_SHUFFLE(2, 3, 0, 1)));
+			minT = _mm_min_ps(minT, _mm_shuffle_ps(minT, minT, _MM_SHUFFLE(1, 0, 3, 2)));
+
+			const float t{ _mm_cvtss_f32(minT) };
+			if (t == std::numeric_limits<float>::infinity())
+				return false;
+
+			const int laneMask{ _mm_movemask_ps(_mm_cmpeq_ps(lowT, minT)) | (_mm_movemask_ps(_mm_cmpeq_ps(highT, minT)) << 4) };
+			const int lane{ std::countr_zero(static_cast<unsigned int>(laneMask)) };
+
+			hitRecord.didHit = true;
+			hitRecord.t = t;
+			hitRecord.normal = { block.normalX[lane], block.normalY[lane], block.normalZ[lane] };
+			return true;
+		}
+
+		TARGET_SSE4 bool DoesHit_SSE4(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray)
+		{
+			const CullMasks cullMasks{ GetCullMasks(cullMode) };
+			const __m128 infinity{ _mm_set1_ps(std::numeric_limits<float>::infinity()) };
+
+			if (_mm_movemask_ps(_mm_cmplt_ps(Intersect_SSE4(block, 0, cullMasks, false, ray), infinity)) != 0)
+				return true;
+
+			return triangleCount > 4 && _mm_movemask_ps(_mm_cmplt_ps(Intersect_SSE4(block, 4, cullMasks, false, ray), infinity)) != 0;
+		}
+#pragma endregion
+
+#pragma region AVX2
+		//Moller-Trumbore on 8 lanes, returns t with every rejected lane set to infinity
+		TARGET_AVX2 __m256 Intersect_AVX2(const TriangleBlock& block, const CullMasks& cullMasks, bool cullOnNormal, const Ray& ray)
+		{
+			const __m256 dirX{ _mm256_set1_ps(ray.direction.x) };
+			const __m256 dirY{ _mm256_set1_ps(ray.direction.y) };
+			const __m256 dirZ{ _mm256_set1_ps(ray.direction.z) };
+
+			const __m256 edge1X{ _mm256_load_ps(block.edge1X) };
+			const __m256 edge1Y{ _mm256_load_ps(block.edge1Y) };
+			const __m256 edge1Z{ _mm256_load_ps(block.edge1Z) };
+			const __m256 edge2X{ _mm256_load_ps(block.edge2X) };
+			const __m256 edge2Y{ _mm256_load_ps(block.edge2Y) };
+			const __m256 edge2Z{ _mm256_load_ps(block.edge2Z) };
+
+			//perVec = cross(direction, edge2)
+			const __m256 perX{ _mm256_sub_ps(_mm256_mul_ps(dirY, edge2Z), _mm256_mul_ps(edge2Y, dirZ)) };
+			const __m256 perY{ _mm256_sub_ps(_mm256_mul_ps(dirZ, edge2X), _mm256_mul_ps(edge2Z, dirX)) };
+			const __m256 perZ{ _mm256_sub_ps(_mm256_mul_ps(dirX, edge2Y), _mm256_mul_ps(edge2X, dirY)) };
+			const __m256 det{ _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge1X, perX), _mm256_mul_ps(edge1Y, perY)), _mm256_mul_ps(edge1Z, perZ)) };
+
+			//The closest hit culls on the stored normal like the scalar test, occlusion on the determinant which has the opposite sign
+			__m256 facing{};
+			if (cullOnNormal)
+				facing = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(block.normalX), dirX),
+					_mm256_mul_ps(_mm256_load_ps(block.normalY), dirY)), _mm256_mul_ps(_mm256_load_ps(block.normalZ), dirZ));
+			else
+				facing = _mm256_xor_ps(det, _mm256_set1_ps(-0.f));
+
+			const __m256 culled{ _mm256_xor_ps(_mm256_and_ps(facing, _mm256_castsi256_ps(_mm256_set1_epi32(cullMasks.absMask))),
+				_mm256_castsi256_ps(_mm256_set1_epi32(cullMasks.flipMask))) };
+			__m256 hitMask{ _mm256_cmp_ps(culled, _mm256_setzero_ps(), _CMP_GT_OQ) };
+
+			//A zero determinant gives an infinite or NaN u, both fail the range tests below
+			const __m256 invDet{ _mm256_div_ps(_mm256_set1_ps(1.f), det) };
+
+			const __m256 tVecX{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(block.v0X)) };
+			const __m256 tVecY{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(block.v0Y)) };
+			const __m256 tVecZ{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(block.v0Z)) };
+			const __m256 u{ _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tVecX, perX), _mm256_mul_ps(tVecY, perY)), _mm256_mul_ps(tVecZ, perZ))) };
+
+			//qVec = cross(tVec, edge1)
+			const __m256 qX{ _mm256_sub_ps(_mm256_mul_ps(tVecY, edge1Z), _mm256_mul_ps(edge1Y, tVecZ)) };
+			const __m256 qY{ _mm256_sub_ps(_mm256_mul_ps(tVecZ, edge1X), _mm256_mul_ps(edge1Z, tVecX)) };
+			const __m256 qZ{ _mm256_sub_ps(_mm256_mul_ps(tVecX, edge1Y), _mm256_mul_ps(edge1X, tVecY)) };
+			const __m256 v{ _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, qX), _mm256_mul_ps(dirY, qY)), _mm256_mul_ps(dirZ, qZ))) };
+			const __m256 t{ _mm256_mul_ps(invDet, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(edge2X, qX), _mm256_mul_ps(edge2Y, qY)), _mm256_mul_ps(edge2Z, qZ))) };
+
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			hitMask = _mm256_and_ps(hitMask, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+			hitMask = _mm256_and_ps(hitMask, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+			hitMask = _mm256_and_ps(hitMask, _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(ray.min), _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(ray.max), _CMP_LE_OQ)));
+			hitMask = _mm256_and_ps(hitMask, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+
+			return _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), t, hitMask);
+		}
+
+		TARGET_AVX2 bool HitTest_AVX2(const TriangleBlock& block, uint32_t, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord)
+		{
+			const __m256 hitT{ Intersect_AVX2(block, GetCullMasks(cullMode), true, ray) };
+
+			//Horizontal min, every lane ends up holding the nearest t
+			__m256 minT{ _mm256_min_ps(hitT, _mm256_permute2f128_ps(hitT, hitT, 1)) };
+			minT = _mm256_min_ps(minT, _mm256_shuffle_ps(minT, minT, _MM_SHUFFLE(2, 3, 0, 1)));
+			minT = _mm256_min_ps(minT, _mm256_shuffle_ps(minT, minT, _MM_SHUFFLE(1, 0, 3, 2)));
+
+			const float t{ _mm256_cvtss_f32(minT) };
+			if (t == std::numeric_limits<float>::infinity())
+				return false;
+
+			const int laneMask{ _mm256_movemask_ps(_mm256_cmp_ps(hitT, minT, _CMP_EQ_OQ)) };
+			const int lane{ std::countr_zero(static_cast<unsigned int>(laneMask)) };
+
+			hitRecord.didHit = true;
+			hitRecord.t = t;
+			hitRecord.normal = { block.normalX[lane], block.normalY[lane], block.normalZ[lane] };
+			return true;
+		}
+
+		TARGET_AVX2 bool DoesHit_AVX2(const TriangleBlock& block, uint32_t, TriangleCullMode cullMode, const Ray& ray)
+		{
+			const __m256 hitT{ Intersect_AVX2(block, GetCullMasks(cullMode), false, ray) };
+			return _mm256_movemask_ps(_mm256_cmp_ps(hitT, _mm256_set1_ps(std::numeric_limits<float>::infinity()), _CMP_LT_OQ)) != 0;
+		}
+#pragma endregion
+
+#pragma region Dispatch
+		bool IsSupported(TriangleKernel kernel)
+		{
+#ifdef _MSC_VER
+			int info[4]{};
+			__cpuid(info, 0);
+			const int maxLeaf{ info[0] };
+
+			__cpuid(info, 1);
+			const bool sse4{ (info[2] & (1 << 19)) != 0 };
+			//AVX registers are only usable when the OS saves them on a context switch
+			const bool osAVX{ (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6 };
+
+			bool avx2{};
+			if (maxLeaf >= 7 && osAVX)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			const bool sse4{ __builtin_cpu_supports("sse4.1") != 0 };
+			const bool avx2{ __builtin_cpu_supports("avx2") != 0 };
+#endif
+
+			switch (kernel)
+			{
+			case TriangleKernel::AVX2:
+				return avx2;
+			case TriangleKernel::SSE4:
+				return sse4;
+			default:
+				return true;
+			}
+		}
+
+		struct KernelTable
+		{
+			TriangleKernel kernel;
+			HitTestFunction hitTest;
+			DoesHitFunction doesHit;
+		};
+
+		KernelTable GetKernelTable(TriangleKernel kernel)
+		{
+			switch (kernel)
+			{
+			case TriangleKernel::AVX2:
+				return { kernel, HitTest_AVX2, DoesHit_AVX2 };
+			case TriangleKernel::SSE4:
+				return { kernel, HitTest_SSE4, DoesHit_SSE4 };
+			default:
+				return { kernel, HitTest_Scalar, DoesHit_Scalar };
+			}
+		}
+
+		KernelTable SelectBestKernel()
+		{
+			if (IsSupported(TriangleKernel::AVX2))
+				return GetKernelTable(TriangleKernel::AVX2);
+			if (IsSupported(TriangleKernel::SSE4))
+				return GetKernelTable(TriangleKernel::SSE4);
+			return GetKernelTable(TriangleKernel::Scalar);
+		}
+
+		KernelTable g_Kernels{ SelectBestKernel() };
+#pragma endregion
+	}
+
+	bool GeometryUtils::HitTest_TriangleBlock(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord)
+	{
+		//Counted here rather than in the kernels, the scalar kernel reuses the single triangle tests
+		Statistics::GetThreadStatistics().triangleTests += triangleCount;
+		return g_Kernels.hitTest(block, triangleCount, cullMode, ray, hitRecord);
+	}
+
+	bool GeometryUtils::DoesHit_TriangleBlock(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray)
+	{
+		Statistics::GetThreadStatistics().triangleTests += triangleCount;
+		return g_Kernels.doesHit(block, triangleCount, cullMode, ray);
+	}
+
+	TriangleKernel GeometryUtils::GetTriangleKernel()
+	{
+		return g_Kernels.kernel;
+	}
+
+	bool GeometryUtils::SetTriangleKernel(TriangleKernel kernel)
+	{
+		if (!IsSupported(kernel))
+			return false;
+
+		//Not synchronized with rendering threads, switch between frames
+		g_Kernels = GetKernelTable(kernel);
+		return true;
+	}
+
+	const char* GeometryUtils::GetTriangleKernelName(TriangleKernel kernel)
+	{
+		switch (kernel)
+		{
+		case TriangleKernel::AVX2:
+			return "AVX2";
+		case TriangleKernel::SSE4:
+			return "SSE4.1";
+		default:
+			return "Scalar";
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	enum class TriangleKernel
+	{
+		Scalar,
+		SSE4,
+		AVX2
+	};
+
+	namespace GeometryUtils
+	{
+		/**
+		 * \brief Closest hit of a ray against all triangles of a block, culling and the nearest-hit selection are branchless
+		 * \param triangleCount number of used lanes, lets the SSE kernel skip an empty upper half
+		 * \param cullMode culling as seen by this ray
+		 * \param hitRecord receives didHit, t and the face normal of the nearest triangle hit between ray.min and ray.max
+		 * \return true when a triangle of the block is hit
+		 */
+		bool HitTest_TriangleBlock(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord);
+
+		/**
+		 * \brief Occlusion-only test of a ray against all triangles of a block
+		 * \param triangleCount number of used lanes, lets the SSE kernel skip an empty upper half
+		 * \param cullMode culling as seen by this ray, shadow rays pass the flipped mode of the mesh
+		 * \return true when any triangle of the block is hit between ray.min and ray.max
+		 */
+		bool DoesHit_TriangleBlock(const TriangleBlock& block, uint32_t triangleCount, TriangleCullMode cullMode, const Ray& ray);
+
+		//Kernel picked at startup, the widest one the CPU supports
+		TriangleKernel GetTriangleKernel();
+		//Forces a kernel, returns false and keeps the current one when the CPU doesn't support it
+		bool SetTriangleKernel(TriangleKernel kernel);
+		const char* GetTriangleKernelName(TriangleKernel kernel);
+	}
+}
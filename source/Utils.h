@@ -1,8 +1,14 @@
 #pragma once
+#include <bit>
 #include <cassert>
 #include <fstream>
+#include <immintrin.h>
+#include <span>
 #include "Math.h"
 #include "DataTypes.h"
+#include "OBJParser.h"
+#include "RenderStatistics.h"
+#include "TriangleKernels.h"
 
 namespace dae
 {
@@ -12,6 +18,8 @@ namespace dae
 		//SPHERE HIT-TESTS
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			++Statistics::GetThreadStatistics().sphereTests;
+
 			float a{ Vector3::Dot(ray.direction, ray.direction) };
 			float b{ (Vector3::Dot(2 * ray.direction, (ray.origin - sphere.origin))) };
 			float c{ Vector3::Dot((ray.origin - sphere.origin), (ray.origin - sphere.origin)) - (sphere.radius * sphere.radius) };
@@ -46,16 +54,37 @@ namespace dae
 			return false;
 		}
 
+		//Occlusion only, no hit record gets written
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Sphere(sphere, ray, temp, true);
+			++Statistics::GetThreadStatistics().sphereTests;
+
+			const Vector3 originToCenter{ ray.origin - sphere.origin };
+			const float a{ Vector3::Dot(ray.direction, ray.direction) };
+			const float b{ 2 * Vector3::Dot(ray.direction, originToCenter) };
+			const float c{ Vector3::Dot(originToCenter, originToCenter) - (sphere.radius * sphere.radius) };
+
+			const float discriminant{ (b * b) - (4 * a * c) };
+			if (discriminant <= 0.f)
+				return false;
+
+			const float sqrtCalculation{ sqrtf(discriminant) };
+			const float divider{ (2 * a) };
+
+			const float t0{ (-b - sqrtCalculation) / divider };
+			if (t0 >= ray.min && t0 <= ray.max)
+				return true;
+
+			const float t1{ (-b + sqrtCalculation) / divider };
+			return t1 >= ray.min && t1 <= ray.max;
 		}
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			++Statistics::GetThreadStatistics().planeTests;
+
 			float t{ Vector3::Dot((plane.origin - ray.origin), plane.normal) };
 			t /= Vector3::Dot(ray.direction, plane.normal);
 			if (t > ray.min && t < ray.max)
@@ -72,10 +101,13 @@ namespace dae
 			return false;
 		}
 
+		//Occlusion only, no hit record gets written
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			++Statistics::GetThreadStatistics().planeTests;
+
+			const float t{ Vector3::Dot((plane.origin - ray.origin), plane.normal) / Vector3::Dot(ray.direction, plane.normal) };
+			return t > ray.min && t < ray.max;
 		}
 #pragma endregion
 #pragma region Triangle HitTest
@@ -257,9 +289,107 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Triangle(triangle, ray, temp, true);
 		}
+
+		//Moller-Trumbore on a baked triangle, only t and the object space normal are written
+		inline bool HitTest_Triangle(const PrecomputedTriangle& triangle, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord)
+		{
+			const Vector3 perVec{ Vector3::Cross(ray.direction, triangle.edge2) };
+			const float dot{ Vector3::Dot(triangle.edge1, perVec) };
+
+			//Culling first, it's the cheapest way out
+			const float normalDot{ Vector3::Dot(triangle.normal, ray.direction) };
+			switch (cullMode)
+			{
+			case TriangleCullMode::FrontFaceCulling:
+				if (normalDot < 0)
+					return false;
+				break;
+			case TriangleCullMode::BackFaceCulling:
+				if (normalDot > 0)
+					return false;
+				break;
+			case TriangleCullMode::NoCulling:
+				if (normalDot == 0)
+					return false;
+				break;
+			default:
+				break;
+			}
+
+			//Parallel to the plane of the triangle, would divide by zero
+			if (dot == 0.f)
+				return false;
+
+			const float invDet{ 1 / dot };
+
+			const Vector3 tVec{ ray.origin - triangle.v0 };
+			const float u{ invDet * Vector3::Dot(tVec, perVec) };
+			if (u < 0.f || u > 1.f)
+				return false;
+
+			const Vector3 qVec{ Vector3::Cross(tVec, triangle.edge1) };
+			const float v{ invDet * Vector3::Dot(ray.direction, qVec) };
+			if (v < 0.f || u + v > 1.f)
+				return false;
+
+			const float t{ invDet * Vector3::Dot(triangle.edge2, qVec) };
+			if (t < ray.min || t > ray.max || t <= 0)
+				return false;
+
+			hitRecord.didHit = true;
+			hitRecord.t = t;
+			hitRecord.normal = triangle.normal;
+			return true;
+		}
+
+		/**
+		 * \brief Occlusion-only Moller-Trumbore, culls on the sign of the determinant so the normal is never needed
+		 * \param cullMode culling as seen by this ray, shadow rays pass the flipped mode of the mesh
+		 * \return true when the triangle is hit between ray.min and ray.max
+		 */
+		inline bool DoesHit_Triangle(const PrecomputedTriangle& triangle, TriangleCullMode cullMode, const Ray& ray)
+		{
+			const Vector3& v0v1{ triangle.edge1 };
+			const Vector3& v0v2{ triangle.edge2 };
+			const Vector3 perVec{ Vector3::Cross(ray.direction, v0v2) };
+
+			//det = -dot(cross(v0v1, v0v2), direction), so it has the opposite sign of dot(normal, direction)
+			const float det{ Vector3::Dot(v0v1, perVec) };
+			switch (cullMode)
+			{
+			case TriangleCullMode::FrontFaceCulling:
+				if (det > 0.f)
+					return false;
+				break;
+			case TriangleCullMode::BackFaceCulling:
+				if (det < 0.f)
+					return false;
+				break;
+			default:
+				break;
+			}
+
+			if (det == 0.f)
+				return false;
+
+			const float invDet{ 1.f / det };
+
+			const Vector3 tVec{ ray.origin - triangle.v0 };
+			const float u{ invDet * Vector3::Dot(tVec, perVec) };
+			if (u < 0.f || u > 1.f)
+				return false;
+
+			const Vector3 qVec{ Vector3::Cross(tVec, v0v1) };
+			const float v{ invDet * Vector3::Dot(ray.direction, qVec) };
+			if (v < 0.f || u + v > 1.f)
+				return false;
+
+			const float t{ invDet * Vector3::Dot(v0v2, qVec) };
+			return t >= ray.min && t <= ray.max && t > 0.f;
+		}
 #pragma endregion
 #pragma region SlabTest TriangleMesh
-		inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		inline bool SlabTest_TriangleMesh(const TriangleMeshInstance& mesh, const Ray& ray)
 		{
 			float tx1 = (mesh.transformedMinAABB.x - ray.origin.x) / ray.direction.x;
 			float tx2 = (mesh.transformedMaxAABB.x - ray.origin.x) / ray.direction.x;
@@ -282,46 +412,659 @@ namespace dae
 			return tmax > 0 && tmax >= tmin;
 		}
 #pragma endregion
-#pragma region TriangeMesh HitTest
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+#pragma region SlabTest BVHNode
+		//Returns the distance at which the ray enters the node, FLT_MAX when it misses
+		inline float SlabTest_BVHNode(const BVHNode& node, const Ray& ray, const Vector3& invDirection)
 		{
-			//todo W5
-			//assert(false && "No Implemented Yet!");
+			++Statistics::GetThreadStatistics().nodeVisits;
+
+			float tx1 = (node.minAABB.x - ray.origin.x) * invDirection.x;
+			float tx2 = (node.maxAABB.x - ray.origin.x) * invDirection.x;
+
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			float ty1 = (node.minAABB.y - ray.origin.y) * invDirection.y;
+			float ty2 = (node.maxAABB.y - ray.origin.y) * invDirection.y;
+
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			float tz1 = (node.minAABB.z - ray.origin.z) * invDirection.z;
+			float tz2 = (node.maxAABB.z - ray.origin.z) * invDirection.z;
+
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
 
-			//slabtest
-			if (!SlabTest_TriangleMesh(mesh, ray))
+			if (tmax >= tmin && tmax > 0 && tmin < ray.max)
+				return tmin;
+
+			return FLT_MAX;
+		}
+#pragma endregion
+#pragma region BVH Traversal
+		/**
+		 * \brief Walks a BVH front-to-back, calling leafFunction(leaf, ray) for every leaf the ray reaches
+		 * \param nodes node array created by BVH::Build
+		 * \param ray ray in the space of the BVH, leafFunction shrinks ray.max on a hit to cull farther nodes
+		 * \param leafFunction returns true to stop the traversal
+		 * \return true when leafFunction stopped the traversal
+		 */
+		template<typename LeafFunction>
+		inline bool TraverseBVH(std::span<const BVHNode> nodes, Ray& ray, const LeafFunction& leafFunction)
+		{
+			if (nodes.empty())
 				return false;
-			
-			auto triangle = Triangle{};
-			int nrOfTriangles{ (int)mesh.transformedNormals.size() };
-			HitRecord closestHit{};
 
-			for (int i{}; i < nrOfTriangles; ++i)
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			const BVHNode* pNode{ &nodes[0] };
+			if (SlabTest_BVHNode(*pNode, ray, invDirection) == FLT_MAX)
+				return false;
+
+			struct StackEntry
+			{
+				const BVHNode* pNode;
+				float distance;
+			};
+			StackEntry stack[BVH_MAX_DEPTH];
+			uint32_t stackSize{};
+
+			while (true)
+			{
+				if (pNode->IsLeaf())
+				{
+					if (leafFunction(*pNode, ray))
+						return true;
+				}
+				else
+				{
+					//Visit the nearest child first, the other one goes on the stack
+					const BVHNode* pNear{ &nodes[pNode->leftFirst] };
+					const BVHNode* pFar{ pNear + 1 };
+					float nearDistance{ SlabTest_BVHNode(*pNear, ray, invDirection) };
+					float farDistance{ SlabTest_BVHNode(*pFar, ray, invDirection) };
+					if (nearDistance > farDistance)
+					{
+						std::swap(pNear, pFar);
+						std::swap(nearDistance, farDistance);
+					}
+
+					if (nearDistance != FLT_MAX)
+					{
+						if (farDistance != FLT_MAX)
+							stack[stackSize++] = { pFar, farDistance };
+
+						pNode = pNear;
+						continue;
+					}
+				}
+
+				//Pop the next node that is still in front of the closest hit
+				pNode = nullptr;
+				while (stackSize > 0)
+				{
+					const StackEntry& entry{ stack[--stackSize] };
+					if (entry.distance <= ray.max)
+					{
+						pNode = entry.pNode;
+						break;
+					}
+				}
+
+				if (!pNode)
+					return false;
+			}
+		}
+
+		/**
+		 * \brief Any-hit walk for occlusion queries, children are ordered by the ray direction sign on the split axis
+		 * \param nodes node array created by BVH::Build
+		 * \param ray ray in the space of the BVH
+		 * \param leafFunction returns true as soon as a leaf primitive blocks the ray
+		 * \return true when any leaf reported a hit
+		 */
+		template<typename LeafFunction>
+		inline bool TraverseBVH_AnyHit(std::span<const BVHNode> nodes, const Ray& ray, const LeafFunction& leafFunction)
+		{
+			if (nodes.empty())
+				return false;
+
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+			const bool directionIsNegative[3]{ ray.direction.x < 0.f, ray.direction.y < 0.f, ray.direction.z < 0.f };
+
+			//No distances are kept, the first hit ends the walk anyway
+			const BVHNode* stack[BVH_MAX_DEPTH * 2];
+			uint32_t stackSize{};
+			stack[stackSize++] = &nodes[0];
+
+			while (stackSize > 0)
 			{
-				triangle.v0 = mesh.transformedPositions[mesh.indices[i * 3]];
-				triangle.v1 = mesh.transformedPositions[mesh.indices[i * 3 + 1]];
-				triangle.v2 = mesh.transformedPositions[mesh.indices[i * 3 + 2]];
+				const BVHNode* pNode{ stack[--stackSize] };
+				if (SlabTest_BVHNode(*pNode, ray, invDirection) == FLT_MAX)
+					continue;
+
+				if (pNode->IsLeaf())
+				{
+					if (leafFunction(*pNode))
+						return true;
 
-				triangle.normal = mesh.transformedNormals[i];
-				triangle.cullMode = mesh.cullMode;
-				triangle.materialIndex = mesh.materialIndex;
+					continue;
+				}
 
-				if (HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord))
+				//The left child holds the lower half of the split axis, push the far child first
+				const BVHNode* pLeft{ &nodes[pNode->leftFirst] };
+				if (directionIsNegative[pNode->splitAxis])
 				{
-					if (closestHit.t > hitRecord.t)
-						closestHit = hitRecord;
+					stack[stackSize++] = pLeft;
+					stack[stackSize++] = pLeft + 1;
+				}
+				else
+				{
+					stack[stackSize++] = pLeft + 1;
+					stack[stackSize++] = pLeft;
 				}
 			}
 
+			return false;
+		}
+#pragma endregion
+#pragma region TriangeMesh HitTest
+		//3x4 affine transform of a ray to the object space of a mesh instance, the direction is not renormalized so t is the same in both spaces
+		inline Ray TransformRayToObject(const TriangleMeshInstance& instance, const Ray& ray)
+		{
+			const float* pMatrix{ instance.worldToObject.GetData() };
+			const __m128 row0{ _mm_loadu_ps(pMatrix) };
+			const __m128 row1{ _mm_loadu_ps(pMatrix + 4) };
+			const __m128 row2{ _mm_loadu_ps(pMatrix + 8) };
+			const __m128 row3{ _mm_loadu_ps(pMatrix + 12) };
+
+			//Same order of operations as Matrix::TransformPoint and TransformVector
+			const __m128 origin{ _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(row0, _mm_set1_ps(ray.origin.x)), _mm_mul_ps(row1, _mm_set1_ps(ray.origin.y))),
+				_mm_mul_ps(row2, _mm_set1_ps(ray.origin.z))), row3) };
+			const __m128 direction{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(row0, _mm_set1_ps(ray.direction.x)), _mm_mul_ps(row1, _mm_set1_ps(ray.direction.y))),
+				_mm_mul_ps(row2, _mm_set1_ps(ray.direction.z))) };
+
+			alignas(16) float objectOrigin[4];
+			alignas(16) float objectDirection[4];
+			_mm_store_ps(objectOrigin, origin);
+			_mm_store_ps(objectDirection, direction);
+			return Ray{ { objectOrigin[0], objectOrigin[1], objectOrigin[2] }, { objectDirection[0], objectDirection[1], objectDirection[2] }, ray.min, ray.max };
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMeshInstance& instance, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const TriangleMesh& mesh{ *instance.pMesh };
+			const std::span<const BVHNode> nodes{ mesh.GetBVHNodes() };
+			const TriangleBlock* pBlocks{ mesh.GetTriangleBlocks().data() };
+			const uint32_t* pLeafFirstBlock{ mesh.GetBVHLeafFirstBlock().data() };
+
+			//The direction is not renormalized, so t in object space equals t in world space
+			Ray objectRay{ TransformRayToObject(instance, ray) };
+
+			TriangleCullMode cullMode{ instance.cullMode };
+			if (ignoreHitRecord && cullMode == TriangleCullMode::BackFaceCulling)
+				cullMode = TriangleCullMode::FrontFaceCulling;
+			else if (ignoreHitRecord && cullMode == TriangleCullMode::FrontFaceCulling)
+				cullMode = TriangleCullMode::BackFaceCulling;
+
+			HitRecord closestHit{};
+
+			TraverseBVH(nodes, objectRay, [&](const BVHNode& leaf, Ray& leafRay)
+				{
+					const TriangleBlock* pBlock{ &pBlocks[pLeafFirstBlock[&leaf - nodes.data()]] };
+					for (uint32_t first{}; first < leaf.primitiveCount; first += TRIANGLE_BLOCK_WIDTH, ++pBlock)
+					{
+						if (HitTest_TriangleBlock(*pBlock, std::min(leaf.primitiveCount - first, TRIANGLE_BLOCK_WIDTH), cullMode, leafRay, closestHit))
+							leafRay.max = closestHit.t;
+					}
+					return false;
+				});
+
+			if (closestHit.didHit)
+			{
+				closestHit.materialIndex = instance.materialIndex;
+				closestHit.origin = ray.origin + ray.direction * closestHit.t;
+				closestHit.normal = instance.TransformNormal(closestHit.normal);
+			}
+
 			hitRecord = closestHit;
 
 			return closestHit.didHit;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		//Occlusion only: stops at the first blocking triangle and never builds a hit record
+		inline bool HitTest_TriangleMesh(const TriangleMeshInstance& instance, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			const TriangleMesh& mesh{ *instance.pMesh };
+			const std::span<const BVHNode> nodes{ mesh.GetBVHNodes() };
+			const TriangleBlock* pBlocks{ mesh.GetTriangleBlocks().data() };
+			const uint32_t* pLeafFirstBlock{ mesh.GetBVHLeafFirstBlock().data() };
+
+			const Ray objectRay{ TransformRayToObject(instance, ray) };
+
+			//Shadow rays travel towards the light, so they see the culling of the mesh flipped
+			TriangleCullMode cullMode{ instance.cullMode };
+			if (cullMode == TriangleCullMode::BackFaceCulling)
+				cullMode = TriangleCullMode::FrontFaceCulling;
+			else if (cullMode == TriangleCullMode::FrontFaceCulling)
+				cullMode = TriangleCullMode::BackFaceCulling;
+
+			return TraverseBVH_AnyHit(nodes, objectRay, [&](const BVHNode& leaf)
+				{
+					const TriangleBlock* pBlock{ &pBlocks[pLeafFirstBlock[&leaf - nodes.data()]] };
+					for (uint32_t first{}; first < leaf.primitiveCount; first += TRIANGLE_BLOCK_WIDTH, ++pBlock)
+					{
+						if (DoesHit_TriangleBlock(*pBlock, std::min(leaf.primitiveCount - first, TRIANGLE_BLOCK_WIDTH), cullMode, objectRay))
+							return true;
+					}
+					return false;
+				});
+		}
+#pragma region Packet HitTests
+		//Calls laneFunction(lane) for every set bit of laneMask
+		template<typename LaneFunction>
+		inline void ForEachLane(uint32_t laneMask, const LaneFunction& laneFunction)
+		{
+			for (; laneMask != 0; laneMask &= laneMask - 1)
+			{
+				laneFunction(static_cast<uint32_t>(std::countr_zero(laneMask)));
+			}
+		}
+
+		//Sphere test on the 4 lanes starting at firstLane, same math as the single ray test
+		//Returns the lanes that hit between min and max, t holds the nearest valid intersection of those lanes
+		inline __m128 IntersectSphere4(const Sphere& sphere, const RayPacket& packet, uint32_t firstLane, __m128& t)
+		{
+			const __m128 directionX{ _mm_load_ps(packet.directionX + firstLane) };
+			const __m128 directionY{ _mm_load_ps(packet.directionY + firstLane) };
+			const __m128 directionZ{ _mm_load_ps(packet.directionZ + firstLane) };
+			const __m128 originToCenterX{ _mm_sub_ps(_mm_load_ps(packet.originX + firstLane), _mm_set1_ps(sphere.origin.x)) };
+			const __m128 originToCenterY{ _mm_sub_ps(_mm_load_ps(packet.originY + firstLane), _mm_set1_ps(sphere.origin.y)) };
+			const __m128 originToCenterZ{ _mm_sub_ps(_mm_load_ps(packet.originZ + firstLane), _mm_set1_ps(sphere.origin.z)) };
+			const __m128 two{ _mm_set1_ps(2.f) };
+
+			const __m128 a{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, directionX), _mm_mul_ps(directionY, directionY)), _mm_mul_ps(directionZ, directionZ)) };
+			const __m128 b{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, directionX), originToCenterX), _mm_mul_ps(_mm_mul_ps(two, directionY), originToCenterY)),
+				_mm_mul_ps(_mm_mul_ps(two, directionZ), originToCenterZ)) };
+			const __m128 c{ _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(originToCenterX, originToCenterX), _mm_mul_ps(originToCenterY, originToCenterY)),
+				_mm_mul_ps(originToCenterZ, originToCenterZ)), _mm_set1_ps(sphere.radius * sphere.radius)) };
+
+			const __m128 discriminant{ _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), a), c)) };
+			const __m128 sqrtCalculation{ _mm_sqrt_ps(discriminant) };
+			const __m128 divider{ _mm_mul_ps(two, a) };
+			const __m128 minusB{ _mm_xor_ps(b, _mm_set1_ps(-0.f)) };
+
+			const __m128 rayMin{ _mm_load_ps(packet.min + firstLane) };
+			const __m128 rayMax{ _mm_load_ps(packet.max + firstLane) };
+			const __m128 t0{ _mm_div_ps(_mm_sub_ps(minusB, sqrtCalculation), divider) };
+			const __m128 t1{ _mm_div_ps(_mm_add_ps(minusB, sqrtCalculation), divider) };
+			const __m128 t0Valid{ _mm_and_ps(_mm_cmpge_ps(t0, rayMin), _mm_cmple_ps(t0, rayMax)) };
+			const __m128 t1Valid{ _mm_and_ps(_mm_cmpge_ps(t1, rayMin), _mm_cmple_ps(t1, rayMax)) };
+
+			t = _mm_or_ps(_mm_and_ps(t0Valid, t0), _mm_andnot_ps(t0Valid, t1));
+			return _mm_and_ps(_mm_cmpgt_ps(discriminant, _mm_setzero_ps()), _mm_or_ps(t0Valid, t1Valid));
+		}
+
+		//Plane test on the 4 lanes starting at firstLane, returns the lanes that hit between min and max
+		inline __m128 IntersectPlane4(const Plane& plane, const RayPacket& packet, uint32_t firstLane, __m128& t)
+		{
+			const __m128 normalX{ _mm_set1_ps(plane.normal.x) };
+			const __m128 normalY{ _mm_set1_ps(plane.normal.y) };
+			const __m128 normalZ{ _mm_set1_ps(plane.normal.z) };
+			const __m128 toPlaneX{ _mm_sub_ps(_mm_set1_ps(plane.origin.x), _mm_load_ps(packet.originX + firstLane)) };
+			const __m128 toPlaneY{ _mm_sub_ps(_mm_set1_ps(plane.origin.y), _mm_load_ps(packet.originY + firstLane)) };
+			const __m128 toPlaneZ{ _mm_sub_ps(_mm_set1_ps(plane.origin.z), _mm_load_ps(packet.originZ + firstLane)) };
+
+			const __m128 distance{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(toPlaneX, normalX), _mm_mul_ps(toPlaneY, normalY)), _mm_mul_ps(toPlaneZ, normalZ)) };
+			const __m128 normalDot{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(packet.directionX + firstLane), normalX),
+				_mm_mul_ps(_mm_load_ps(packet.directionY + firstLane), normalY)), _mm_mul_ps(_mm_load_ps(packet.directionZ + firstLane), normalZ)) };
+
+			t = _mm_div_ps(distance, normalDot);
+			return _mm_and_ps(_mm_cmpgt_ps(t, _mm_load_ps(packet.min + firstLane)), _mm_cmplt_ps(t, _mm_load_ps(packet.max + firstLane)));
+		}
+
+		/**
+		 * \brief Sphere test for every lane of laneMask
+		 * \param hitRecords one record per lane, only the records of the returned lanes are written
+		 * \return lanes that hit the sphere between their min and max
+		 */
+		inline uint32_t HitTest_Sphere(const Sphere& sphere, const RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			Statistics::GetThreadStatistics().sphereTests += std::popcount(laneMask);
+
+			alignas(16) float t[RAY_PACKET_SIZE];
+			uint32_t hitMask{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				if (((laneMask >> firstLane) & 0xF) == 0)
+					continue;
+
+				__m128 groupT{};
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(IntersectSphere4(sphere, packet, firstLane, groupT))) << firstLane;
+				_mm_store_ps(t + firstLane, groupT);
+			}
+			hitMask &= laneMask;
+
+			ForEachLane(hitMask, [&](uint32_t lane)
+				{
+					const Ray ray{ packet.GetRay(lane) };
+					const Vector3 pointI1{ ray.origin + ray.direction * t[lane] };
+					HitRecord& hitRecord{ hitRecords[lane] };
+					hitRecord.didHit = true;
+					hitRecord.t = t[lane];
+					hitRecord.materialIndex = sphere.materialIndex;
+					hitRecord.origin = pointI1;
+					hitRecord.normal = (pointI1 - sphere.origin) / sphere.radius;
+				});
+
+			return hitMask;
+		}
+
+		//Occlusion only, returns the lanes of laneMask that hit the sphere
+		inline uint32_t HitTest_Sphere(const Sphere& sphere, const RayPacket& packet, uint32_t laneMask)
+		{
+			Statistics::GetThreadStatistics().sphereTests += std::popcount(laneMask);
+
+			uint32_t hitMask{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				if (((laneMask >> firstLane) & 0xF) == 0)
+					continue;
+
+				__m128 t{};
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(IntersectSphere4(sphere, packet, firstLane, t))) << firstLane;
+			}
+			return hitMask & laneMask;
+		}
+
+		/**
+		 * \brief Plane test for every lane of laneMask
+		 * \param hitRecords one record per lane, only the records of the returned lanes are written
+		 * \return lanes that hit the plane between their min and max
+		 */
+		inline uint32_t HitTest_Plane(const Plane& plane, const RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			Statistics::GetThreadStatistics().planeTests += std::popcount(laneMask);
+
+			alignas(16) float t[RAY_PACKET_SIZE];
+			uint32_t hitMask{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				if (((laneMask >> firstLane) & 0xF) == 0)
+					continue;
+
+				__m128 groupT{};
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(IntersectPlane4(plane, packet, firstLane, groupT))) << firstLane;
+				_mm_store_ps(t + firstLane, groupT);
+			}
+			hitMask &= laneMask;
+
+			ForEachLane(hitMask, [&](uint32_t lane)
+				{
+					const Ray ray{ packet.GetRay(lane) };
+					HitRecord& hitRecord{ hitRecords[lane] };
+					hitRecord.didHit = true;
+					hitRecord.t = t[lane];
+					hitRecord.materialIndex = plane.materialIndex;
+					hitRecord.origin = ray.origin + ray.direction * t[lane];
+					hitRecord.normal = plane.normal;
+				});
+
+			return hitMask;
+		}
+
+		//Occlusion only, returns the lanes of laneMask that hit the plane
+		inline uint32_t HitTest_Plane(const Plane& plane, const RayPacket& packet, uint32_t laneMask)
+		{
+			Statistics::GetThreadStatistics().planeTests += std::popcount(laneMask);
+
+			uint32_t hitMask{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				if (((laneMask >> firstLane) & 0xF) == 0)
+					continue;
+
+				__m128 t{};
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(IntersectPlane4(plane, packet, firstLane, t))) << firstLane;
+			}
+			return hitMask & laneMask;
+		}
+
+		//Returns the lanes of laneMask that enter the node before their max
+		inline uint32_t SlabTest_BVHNode(const BVHNode& node, const RayPacket& packet, const float (&invDirection)[3][RAY_PACKET_SIZE], uint32_t laneMask)
+		{
+			Statistics::GetThreadStatistics().nodeVisits += std::popcount(laneMask);
+
+			const __m128 minX{ _mm_set1_ps(node.minAABB.x) };
+			const __m128 minY{ _mm_set1_ps(node.minAABB.y) };
+			const __m128 minZ{ _mm_set1_ps(node.minAABB.z) };
+			const __m128 maxX{ _mm_set1_ps(node.maxAABB.x) };
+			const __m128 maxY{ _mm_set1_ps(node.maxAABB.y) };
+			const __m128 maxZ{ _mm_set1_ps(node.maxAABB.z) };
+
+			uint32_t hitMask{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				if (((laneMask >> firstLane) & 0xF) == 0)
+					continue;
+
+				const __m128 originX{ _mm_load_ps(packet.originX + firstLane) };
+				const __m128 originY{ _mm_load_ps(packet.originY + firstLane) };
+				const __m128 originZ{ _mm_load_ps(packet.originZ + firstLane) };
+				const __m128 invDirectionX{ _mm_load_ps(invDirection[0] + firstLane) };
+				const __m128 invDirectionY{ _mm_load_ps(invDirection[1] + firstLane) };
+				const __m128 invDirectionZ{ _mm_load_ps(invDirection[2] + firstLane) };
+
+				const __m128 tx1{ _mm_mul_ps(_mm_sub_ps(minX, originX), invDirectionX) };
+				const __m128 tx2{ _mm_mul_ps(_mm_sub_ps(maxX, originX), invDirectionX) };
+				const __m128 ty1{ _mm_mul_ps(_mm_sub_ps(minY, originY), invDirectionY) };
+				const __m128 ty2{ _mm_mul_ps(_mm_sub_ps(maxY, originY), invDirectionY) };
+				const __m128 tz1{ _mm_mul_ps(_mm_sub_ps(minZ, originZ), invDirectionZ) };
+				const __m128 tz2{ _mm_mul_ps(_mm_sub_ps(maxZ, originZ), invDirectionZ) };
+
+				const __m128 tmin{ _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2)) };
+				const __m128 tmax{ _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2)) };
+
+				const __m128 hit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpgt_ps(tmax, _mm_setzero_ps())),
+					_mm_cmplt_ps(tmin, _mm_load_ps(packet.max + firstLane))) };
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << firstLane;
+			}
+			return hitMask & laneMask;
+		}
+
+		/**
+		 * \brief Walks a BVH with a whole packet, a node is visited once for every lane that reaches it
+		 * \param nodes node array created by BVH::Build
+		 * \param packet coherent packet in the space of the BVH, leafFunction shrinks packet.max on a hit to cull farther nodes
+		 * \param leafFunction leafFunction(leaf, packet, laneMask) returns the lanes that are done, e.g. occluded shadow rays
+		 * \return all lanes leafFunction reported as done
+		 */
+		template<typename LeafFunction>
+		inline uint32_t TraverseBVH_Packet(std::span<const BVHNode> nodes, RayPacket& packet, uint32_t laneMask, const LeafFunction& leafFunction)
+		{
+			if (nodes.empty() || laneMask == 0)
+				return 0;
+
+			alignas(16) float invDirection[3][RAY_PACKET_SIZE];
+			for (uint32_t lane{}; lane < RAY_PACKET_SIZE; ++lane)
+			{
+				invDirection[0][lane] = 1.f / packet.directionX[lane];
+				invDirection[1][lane] = 1.f / packet.directionY[lane];
+				invDirection[2][lane] = 1.f / packet.directionZ[lane];
+			}
+
+			//The child order follows the direction signs of the first active lane. Only a heuristic, lanes of an instance transformed packet can
+			//point elsewhere, they just visit the far child first and the closest hit distance still prunes it
+			const uint32_t firstLane{ static_cast<uint32_t>(std::countr_zero(laneMask)) };
+			const bool directionIsNegative[3]{ packet.directionX[firstLane] < 0.f, packet.directionY[firstLane] < 0.f, packet.directionZ[firstLane] < 0.f };
+
+			struct StackEntry
+			{
+				const BVHNode* pNode;
+				uint32_t laneMask;
+			};
+			StackEntry stack[BVH_MAX_DEPTH * 2];
+			uint32_t stackSize{};
+			stack[stackSize++] = { &nodes[0], laneMask };
+
+			uint32_t activeMask{ laneMask };
+			uint32_t doneMask{};
+			while (stackSize > 0)
+			{
+				const StackEntry entry{ stack[--stackSize] };
+				const uint32_t nodeMask{ SlabTest_BVHNode(*entry.pNode, packet, invDirection, entry.laneMask & activeMask) };
+				if (nodeMask == 0)
+					continue;
+
+				if (entry.pNode->IsLeaf())
+				{
+					const uint32_t leafDoneMask{ leafFunction(*entry.pNode, packet, nodeMask) };
+					doneMask |= leafDoneMask;
+					activeMask &= ~leafDoneMask;
+					if (activeMask == 0)
+						break;
+
+					continue;
+				}
+
+				//The left child holds the lower half of the split axis, push the far child first
+				const BVHNode* pLeft{ &nodes[entry.pNode->leftFirst] };
+				if (directionIsNegative[entry.pNode->splitAxis])
+				{
+					stack[stackSize++] = { pLeft, nodeMask };
+					stack[stackSize++] = { pLeft + 1, nodeMask };
+				}
+				else
+				{
+					stack[stackSize++] = { pLeft + 1, nodeMask };
+					stack[stackSize++] = { pLeft, nodeMask };
+				}
+			}
+
+			return doneMask;
+		}
+
+		//Brings the lanes of laneMask to the object space of a mesh instance 4 lanes at a time, t stays the same in both spaces.
+		//Lanes outside laneMask are transformed too but stay inactive
+		inline RayPacket TransformPacketToObject(const TriangleMeshInstance& instance, const RayPacket& packet, uint32_t laneMask)
+		{
+			//Row-major, element (row, column) is at pMatrix[row * 4 + column]
+			const float* pMatrix{ instance.worldToObject.GetData() };
+			const __m128 m00{ _mm_set1_ps(pMatrix[0]) }, m01{ _mm_set1_ps(pMatrix[1]) }, m02{ _mm_set1_ps(pMatrix[2]) };
+			const __m128 m10{ _mm_set1_ps(pMatrix[4]) }, m11{ _mm_set1_ps(pMatrix[5]) }, m12{ _mm_set1_ps(pMatrix[6]) };
+			const __m128 m20{ _mm_set1_ps(pMatrix[8]) }, m21{ _mm_set1_ps(pMatrix[9]) }, m22{ _mm_set1_ps(pMatrix[10]) };
+			const __m128 m30{ _mm_set1_ps(pMatrix[12]) }, m31{ _mm_set1_ps(pMatrix[13]) }, m32{ _mm_set1_ps(pMatrix[14]) };
+
+			RayPacket objectPacket{};
+			for (uint32_t firstLane{}; firstLane < RAY_PACKET_SIZE; firstLane += 4)
+			{
+				const __m128 originX{ _mm_load_ps(packet.originX + firstLane) };
+				const __m128 originY{ _mm_load_ps(packet.originY + firstLane) };
+				const __m128 originZ{ _mm_load_ps(packet.originZ + firstLane) };
+				const __m128 directionX{ _mm_load_ps(packet.directionX + firstLane) };
+				const __m128 directionY{ _mm_load_ps(packet.directionY + firstLane) };
+				const __m128 directionZ{ _mm_load_ps(packet.directionZ + firstLane) };
+
+				//Same order of operations as Matrix::TransformPoint and TransformVector
+				_mm_store_ps(objectPacket.originX + firstLane, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, originX), _mm_mul_ps(m10, originY)), _mm_mul_ps(m20, originZ)), m30));
+				_mm_store_ps(objectPacket.originY + firstLane, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, originX), _mm_mul_ps(m11, originY)), _mm_mul_ps(m21, originZ)), m31));
+				_mm_store_ps(objectPacket.originZ + firstLane, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, originX), _mm_mul_ps(m12, originY)), _mm_mul_ps(m22, originZ)), m32));
+				_mm_store_ps(objectPacket.directionX + firstLane, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, directionX), _mm_mul_ps(m10, directionY)), _mm_mul_ps(m20, directionZ)));
+				_mm_store_ps(objectPacket.directionY + firstLane, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, directionX), _mm_mul_ps(m11, directionY)), _mm_mul_ps(m21, directionZ)));
+				_mm_store_ps(objectPacket.directionZ + firstLane, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, directionX), _mm_mul_ps(m12, directionY)), _mm_mul_ps(m22, directionZ)));
+				_mm_store_ps(objectPacket.min + firstLane, _mm_load_ps(packet.min + firstLane));
+				_mm_store_ps(objectPacket.max + firstLane, _mm_load_ps(packet.max + firstLane));
+			}
+			objectPacket.activeMask = laneMask;
+			return objectPacket;
+		}
+
+		/**
+		 * \brief Closest hit of every lane of laneMask against a mesh instance
+		 * \param hitRecords one record per lane, only the records of the returned lanes are written
+		 * \return lanes that hit the mesh between their min and max
+		 */
+		inline uint32_t HitTest_TriangleMesh(const TriangleMeshInstance& instance, const RayPacket& packet, uint32_t laneMask, HitRecord* hitRecords)
+		{
+			const TriangleMesh& mesh{ *instance.pMesh };
+			const std::span<const BVHNode> nodes{ mesh.GetBVHNodes() };
+			const TriangleBlock* pBlocks{ mesh.GetTriangleBlocks().data() };
+			const uint32_t* pLeafFirstBlock{ mesh.GetBVHLeafFirstBlock().data() };
+			RayPacket objectPacket{ TransformPacketToObject(instance, packet, laneMask) };
+
+			HitRecord closestHits[RAY_PACKET_SIZE]{};
+			uint32_t hitMask{};
+
+			//Every lane runs through the blocks of a leaf while they are still in cache
+			TraverseBVH_Packet(nodes, objectPacket, laneMask, [&](const BVHNode& leaf, RayPacket& leafPacket, uint32_t leafMask)
+				{
+					const TriangleBlock* pFirstBlock{ &pBlocks[pLeafFirstBlock[&leaf - nodes.data()]] };
+					ForEachLane(leafMask, [&](uint32_t lane)
+						{
+							Ray leafRay{ leafPacket.GetRay(lane) };
+							const TriangleBlock* pBlock{ pFirstBlock };
+							for (uint32_t first{}; first < leaf.primitiveCount; first += TRIANGLE_BLOCK_WIDTH, ++pBlock)
+							{
+								if (HitTest_TriangleBlock(*pBlock, std::min(leaf.primitiveCount - first, TRIANGLE_BLOCK_WIDTH), instance.cullMode, leafRay, closestHits[lane]))
+								{
+									leafRay.max = closestHits[lane].t;
+									hitMask |= 1u << lane;
+								}
+							}
+							leafPacket.max[lane] = leafRay.max;
+						});
+					return 0u;
+				});
+
+			ForEachLane(hitMask, [&](uint32_t lane)
+				{
+					const Ray ray{ packet.GetRay(lane) };
+					HitRecord& hitRecord{ hitRecords[lane] };
+					hitRecord = closestHits[lane];
+					hitRecord.materialIndex = instance.materialIndex;
+					hitRecord.origin = ray.origin + ray.direction * hitRecord.t;
+					hitRecord.normal = instance.TransformNormal(hitRecord.normal);
+				});
+
+			return hitMask;
+		}
+
+		//Occlusion only, returns the lanes of laneMask that are blocked by the mesh
+		inline uint32_t HitTest_TriangleMesh(const TriangleMeshInstance& instance, const RayPacket& packet, uint32_t laneMask)
+		{
+			const TriangleMesh& mesh{ *instance.pMesh };
+			const std::span<const BVHNode> nodes{ mesh.GetBVHNodes() };
+			const TriangleBlock* pBlocks{ mesh.GetTriangleBlocks().data() };
+			const uint32_t* pLeafFirstBlock{ mesh.GetBVHLeafFirstBlock().data() };
+			RayPacket objectPacket{ TransformPacketToObject(instance, packet, laneMask) };
+
+			//Shadow rays travel towards the light, so they see the culling of the mesh flipped
+			TriangleCullMode cullMode{ instance.cullMode };
+			if (cullMode == TriangleCullMode::BackFaceCulling)
+				cullMode = TriangleCullMode::FrontFaceCulling;
+			else if (cullMode == TriangleCullMode::FrontFaceCulling)
+				cullMode = TriangleCullMode::BackFaceCulling;
+
+			return TraverseBVH_Packet(nodes, objectPacket, laneMask, [&](const BVHNode& leaf, RayPacket& leafPacket, uint32_t leafMask)
+				{
+					const TriangleBlock* pFirstBlock{ &pBlocks[pLeafFirstBlock[&leaf - nodes.data()]] };
+					uint32_t occludedMask{};
+					ForEachLane(leafMask, [&](uint32_t lane)
+						{
+							const Ray leafRay{ leafPacket.GetRay(lane) };
+							const TriangleBlock* pBlock{ pFirstBlock };
+							for (uint32_t first{}; first < leaf.primitiveCount; first += TRIANGLE_BLOCK_WIDTH, ++pBlock)
+							{
+								if (DoesHit_TriangleBlock(*pBlock, std::min(leaf.primitiveCount - first, TRIANGLE_BLOCK_WIDTH), cullMode, leafRay))
+								{
+									occludedMask |= 1u << lane;
+									break;
+								}
+							}
+						});
+					return occludedMask;
+				});
 		}
 #pragma endregion
 	}
@@ -362,72 +1105,24 @@ namespace dae
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
+		//Parses positions and triangle indices with OBJParser and computes a face normal per triangle
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
+			OBJData data{};
+			if (!OBJParser::Parse(filename, data))
 				return false;
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
+			positions = std::move(data.positions);
+			indices = std::move(data.positionIndices);
 
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
+			normals.clear();
+			normals.reserve(indices.size() / 3);
+			for (size_t index{}; index < indices.size(); index += 3)
 			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
+				const Vector3& v0{ positions[indices[index]] };
+				normals.push_back(Vector3::Cross(positions[indices[index + 1]] - v0, positions[indices[index + 2]] - v0).Normalized());
 			}
 
 			return true;
@@ -5,53 +5,426 @@
 #undef main
 
 //Standard includes
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 //Project includes
 #include "Timer.h"
+#include "Benchmark.h"
+#include "FrameBuffer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
 using namespace dae;
 
+enum ExitCode
+{
+	EXIT_CODE_SUCCESS = 0,
+	EXIT_CODE_STARTUP_FAILED = 1, //Bad arguments, unknown scene or no window/buffer
+	EXIT_CODE_OUTPUT_FAILED = 2, //The output image or benchmark results couldn't be written
+	EXIT_CODE_REGRESSION = 3 //The benchmark got slower than its baseline
+};
+
+struct LaunchOptions
+{
+	std::string sceneName{}; //Empty renders the bunny, or benchmarks every scene
+	int width{ 640 };
+	int height{ 480 };
+
+	bool showHelp{ false };
+	bool isHeadless{ false };
+	bool isBenchmark{ false };
+	uint32_t frameCount{}; //0 uses the default of the mode
+	std::string outputPath{};
+
+	std::string tracePath{};
+	std::string statisticsPath{};
+
+	bool isCostView{ false };
+	Renderer::CostMetric costMetric{ Renderer::CostMetric::Time };
+	uint32_t progressiveSampleCount{}; //0 renders one sample per pixel
+	float targetFrameTime{}; //Milliseconds, 0 always renders at the full resolution
+	bool isReprojecting{ false };
+	std::string costOutputPath{};
+
+	float sceneTime{ 0.f };
+	std::string baselinePath{};
+	float tolerance{ 5.f }; //Percent
+
+	uint32_t threadCount{}; //0 uses every hardware thread
+	uint32_t tileSize{ 16 };
+	bool pinThreads{ false };
+};
+
 void ShutDown(SDL_Window* pWindow)
 {
 	SDL_DestroyWindow(pWindow);
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+void PrintUsage()
+{
+	std::cout << "Usage: RayTracer [options]\n"
+		<< "  --scene <name>       scene class to render, e.g. Scene_W4_BunnyScene (default)\n"
+		<< "  --width <pixels>     default 640\n"
+		<< "  --height <pixels>    default 480\n"
+		<< "  --headless           render without a window and exit when done\n"
+		<< "  --frames <count>     frames to render when headless (default 1) or per benchmarked scene (default 30)\n"
+		<< "  --output <file>      .bmp written after the last headless frame, .json with the benchmark results\n"
+		<< "  --threads <count>    worker threads, default every hardware thread\n"
+		<< "  --tile <pixels>      tile size handed to the workers, default 16\n"
+		<< "  --pin-threads        pin worker i to logical core i\n"
+		<< "  --trace <file>       record every headless frame as a Chrome trace .json\n"
+		<< "  --cost <metric>      render the cost of every pixel as a heatmap, metric is ns, nodes or tests\n"
+		<< "  --cost-output <file> .pfm with the raw costs of the last headless frame\n"
+		<< "  --progressive <n>    accumulate up to n jittered samples per pixel while the view doesn't change (F6 toggles,\n"
+		<< "                       F7 prints the samples per pixel)\n"
+		<< "  --target-ms <ms>     lower the traced resolution while frames take longer than ms and upscale it (F9 toggles)\n"
+		<< "  --reproject          reuse the last frame while only the camera moves, tracing what it can't cover (F10 toggles)\n"
+		<< "  --stats <file>       append ray and intersection counts as JSON lines, every frame when headless, every second otherwise\n"
+		<< "  --benchmark          render every scene, or only --scene, headless at a frozen time and report frame time percentiles\n"
+		<< "  --time <seconds>     scene time the benchmark freezes at, default 0\n"
+		<< "  --baseline <file>    benchmark .json to compare against, exits with 3 when a scene got slower\n"
+		<< "  --tolerance <pct>    slowdown of the p50 or p95 frame time allowed by --baseline, default 5\n";
+}
+
+//Parses a count as signed so "-1" is rejected instead of wrapping around, throws like std::stoll when out of [0, maxValue]
+uint32_t ParseCount(const std::string& value, uint32_t maxValue)
+{
+	const long long count{ std::stoll(value) };
+	if (count < 0 || count > static_cast<long long>(maxValue))
+		throw std::out_of_range{ value };
+
+	return static_cast<uint32_t>(count);
+}
+
+bool ParseArguments(int argc, char* args[], LaunchOptions& options)
+{
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string argument{ args[i] };
+		const bool hasValue{ i + 1 < argc };
+
+		try
+		{
+			if (argument == "--headless")
+				options.isHeadless = true;
+			else if (argument == "--pin-threads")
+				options.pinThreads = true;
+			else if (argument == "--benchmark")
+				options.isBenchmark = true;
+			else if (argument == "--reproject")
+				options.isReprojecting = true;
+			else if (argument == "--help")
+				options.showHelp = true;
+			else if (!hasValue)
+			{
+				std::cout << "Missing value or unknown option " << argument << "\n";
+				return false;
+			}
+			else if (argument == "--scene")
+				options.sceneName = args[++i];
+			else if (argument == "--width")
+				options.width = std::stoi(args[++i]);
+			else if (argument == "--height")
+				options.height = std::stoi(args[++i]);
+			else if (argument == "--frames")
+				options.frameCount = ParseCount(args[++i], UINT32_MAX);
+			else if (argument == "--output")
+				options.outputPath = args[++i];
+			else if (argument == "--threads")
+			{
+				//Every worker gets its own queue, a few per hardware thread is already more than useful
+				const uint32_t hardwareThreadCount{ std::max(std::thread::hardware_concurrency(), 1u) };
+				options.threadCount = ParseCount(args[++i], hardwareThreadCount * 4);
+			}
+			else if (argument == "--tile")
+				options.tileSize = ParseCount(args[++i], 4096);
+			else if (argument == "--trace")
+				options.tracePath = args[++i];
+			else if (argument == "--cost")
+			{
+				const std::string metric{ args[++i] };
+				options.isCostView = true;
+				if (metric == "ns")
+					options.costMetric = Renderer::CostMetric::Time;
+				else if (metric == "nodes")
+					options.costMetric = Renderer::CostMetric::NodeVisits;
+				else if (metric == "tests")
+					options.costMetric = Renderer::CostMetric::PrimitiveTests;
+				else
+				{
+					std::cout << "Unknown cost metric " << metric << "\n";
+					return false;
+				}
+			}
+			else if (argument == "--cost-output")
+				options.costOutputPath = args[++i];
+			else if (argument == "--progressive")
+				options.progressiveSampleCount = std::stoul(args[++i]);
+			else if (argument == "--target-ms")
+				options.targetFrameTime = std::stof(args[++i]);
+			else if (argument == "--stats")
+				options.statisticsPath = args[++i];
+			else if (argument == "--time")
+				options.sceneTime = std::stof(args[++i]);
+			else if (argument == "--baseline")
+				options.baselinePath = args[++i];
+			else if (argument == "--tolerance")
+				options.tolerance = std::stof(args[++i]);
+			else
+			{
+				std::cout << "Unknown option " << argument << "\n";
+				return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cout << "Invalid value " << args[i] << " for " << argument << "\n";
+			return false;
+		}
+	}
+
+	if (options.width <= 0 || options.height <= 0)
+	{
+		std::cout << "Width and height have to be positive\n";
+		return false;
+	}
+
+	if (!options.costOutputPath.empty() && !options.isCostView)
+	{
+		std::cout << "--cost-output needs --cost\n";
+		return false;
+	}
+
+	if (options.frameCount == 0)
+		options.frameCount = options.isBenchmark ? BenchmarkSettings{}.frameCount : 1;
+
+	return true;
+}
+
+//Appends to the file of --stats, returns false when it was given but couldn't be opened
+bool OpenStatisticsFile(const LaunchOptions& options, std::ofstream& statisticsStream)
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	if (options.statisticsPath.empty())
+		return true;
 
+	statisticsStream.open(options.statisticsPath, std::ios::app);
+	if (!statisticsStream)
+	{
+		std::cout << "Could not open " << options.statisticsPath << "\n";
+		return false;
+	}
+	return true;
+}
+
+void ConfigureRenderer(Renderer* pRenderer, const LaunchOptions& options)
+{
+	pRenderer->SetTileSize(options.tileSize);
+	if (options.isCostView)
+	{
+		pRenderer->SetLightingMode(Renderer::LightingMode::Cost);
+		pRenderer->SetCostMetric(options.costMetric);
+	}
+	if (options.progressiveSampleCount > 0)
+	{
+		pRenderer->SetProgressive(true);
+		pRenderer->SetProgressiveTargets(options.progressiveSampleCount, Renderer::DEFAULT_VARIANCE_TARGET);
+	}
+	if (options.targetFrameTime > 0.f)
+	{
+		pRenderer->SetDynamicResolution(true);
+		pRenderer->SetTargetFrameTime(options.targetFrameTime);
+	}
+	if (options.isReprojecting)
+		pRenderer->SetReprojection(true);
+	if (options.threadCount > 0 || options.pinThreads)
+		pRenderer->SetThreadCount(options.threadCount, options.pinThreads ? ThreadPinning::Compact : ThreadPinning::None);
+}
+
+int RunHeadless(const LaunchOptions& options, Scene* pScene)
+{
+	FrameBuffer frameBuffer{ options.width, options.height };
+	if (!frameBuffer.GetPixels())
+	{
+		std::cout << "Could not allocate a " << options.width << "x" << options.height << " frame buffer\n";
+		return EXIT_CODE_STARTUP_FAILED;
+	}
+
+	std::ofstream statisticsStream{};
+	if (!OpenStatisticsFile(options, statisticsStream))
+		return EXIT_CODE_STARTUP_FAILED;
+
+	Timer timer{};
+	Renderer renderer{ &frameBuffer };
+	ConfigureRenderer(&renderer, options);
+	//Headless runs are for timing and traces, they trace every frame even when the scene is static
+	renderer.SetFrameReuse(false);
+
+	pScene->Initialize();
+
+	if (!options.tracePath.empty())
+		Trace::Start();
+
+	timer.Start();
+	for (uint32_t frame{}; frame < options.frameCount; ++frame)
+	{
+		{
+			TRACE_ZONE("Scene::Update");
+			pScene->Update(&timer);
+		}
+		renderer.Render(pScene);
+		timer.Update();
+
+		if (statisticsStream.is_open())
+			statisticsStream << Statistics::ToJSON(renderer.GetFrameStatistics(), timer.GetElapsed()) << "\n";
+	}
+	timer.Stop();
+	Trace::Stop();
+
+	std::cout << "Rendered " << options.frameCount << " frame(s) of " << options.sceneName << " at " << options.width << "x" << options.height
+		<< " (last traced at " << renderer.GetRenderWidth() << "x" << renderer.GetRenderHeight() << ")"
+		<< " in " << timer.GetTotal() << " s (" << timer.GetTotal() * 1000.f / options.frameCount << " ms per frame, "
+		<< renderer.GetThreadCount() << " threads)\n"
+		<< Statistics::ToText(renderer.GetAccumulatedStatistics(), timer.GetTotal()) << "\n";
+	if (options.progressiveSampleCount > 0)
+		std::cout << Statistics::ToText(renderer.GetSampleDistribution());
+
+	if (!options.outputPath.empty())
+	{
+		if (!frameBuffer.SaveToBMP(options.outputPath))
+		{
+			std::cout << "Could not write " << options.outputPath << "\n";
+			return EXIT_CODE_OUTPUT_FAILED;
+		}
+		std::cout << "Saved " << options.outputPath << "\n";
+	}
+
+	if (!options.costOutputPath.empty())
+	{
+		if (!renderer.SaveCostImage(options.costOutputPath))
+		{
+			std::cout << "Could not write " << options.costOutputPath << "\n";
+			return EXIT_CODE_OUTPUT_FAILED;
+		}
+		std::cout << "Saved " << options.costOutputPath << "\n";
+	}
+
+	if (!options.tracePath.empty())
+	{
+		if (!Trace::WriteChromeTrace(options.tracePath))
+		{
+			std::cout << "Could not write " << options.tracePath << "\n";
+			return EXIT_CODE_OUTPUT_FAILED;
+		}
+		std::cout << "Saved " << options.tracePath << "\n";
+	}
+
+	return EXIT_CODE_SUCCESS;
+}
+
+//Starts a capture, or stops the running one and writes it next to the screenshots
+void ToggleTraceCapture()
+{
+	if (!Trace::IsRecording())
+	{
+		Trace::Start();
+		std::cout << "Trace capture started, F5 again to save it" << std::endl;
+		return;
+	}
+
+	Trace::Stop();
+	if (Trace::WriteChromeTrace("RayTracing_Trace.json"))
+		std::cout << "Trace saved!" << std::endl;
+	else
+		std::cout << "Something went wrong. Trace not saved!" << std::endl;
+}
+
+int RunBenchmark(const LaunchOptions& options)
+{
+	BenchmarkSettings settings{};
+	settings.width = options.width;
+	settings.height = options.height;
+	settings.frameCount = options.frameCount;
+	settings.sceneTime = options.sceneTime;
+	settings.threadCount = options.threadCount;
+	settings.tileSize = options.tileSize;
+	settings.pinThreads = options.pinThreads;
+
+	std::vector<BenchmarkResult> baseline{};
+	if (!options.baselinePath.empty() && !Benchmark::ReadJSON(options.baselinePath, baseline))
+	{
+		std::cout << "Could not read the baseline " << options.baselinePath << "\n";
+		return EXIT_CODE_STARTUP_FAILED;
+	}
+
+	const std::vector<std::string> sceneNames{ options.sceneName.empty() ? GetSceneNames() : std::vector<std::string>{ options.sceneName } };
+	std::vector<BenchmarkResult> results{};
+	for (const std::string& sceneName : sceneNames)
+	{
+		BenchmarkResult result{};
+		if (!Benchmark::Run(sceneName, settings, result))
+			return EXIT_CODE_STARTUP_FAILED;
+
+		std::cout << sceneName << ": p50 " << result.p50FrameTime << " ms, p95 " << result.p95FrameTime << " ms, p99 " << result.p99FrameTime << " ms, "
+			<< result.primaryRaysPerSecond / 1e6 << " M primary rays/s, " << result.shadowRaysPerSecond / 1e6 << " M shadow rays/s, "
+			<< result.threadCount << " threads\n";
+		results.push_back(result);
+	}
+
+	const std::string outputPath{ options.outputPath.empty() ? "benchmark.json" : options.outputPath };
+	if (!Benchmark::WriteJSON(outputPath, results))
+	{
+		std::cout << "Could not write " << outputPath << "\n";
+		return EXIT_CODE_OUTPUT_FAILED;
+	}
+	std::cout << "Saved " << outputPath << "\n";
+
+	if (!baseline.empty())
+	{
+		const uint32_t regressionCount{ Benchmark::Compare(baseline, results, options.tolerance / 100.0) };
+		if (regressionCount > 0)
+		{
+			std::cout << regressionCount << " scene(s) regressed by more than " << options.tolerance << "%\n";
+			return EXIT_CODE_REGRESSION;
+		}
+	}
+
+	return EXIT_CODE_SUCCESS;
+}
+
+int RunWindowed(const LaunchOptions& options, Scene* pScene)
+{
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
-
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"RayTracer - Stef Kluskens",
 		SDL_WINDOWPOS_UNDEFINED,
 		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+		options.width, options.height, 0);
 
 	if (!pWindow)
-		return 1;
+		return EXIT_CODE_STARTUP_FAILED;
+
+	std::ofstream statisticsStream{};
+	if (!OpenStatisticsFile(options, statisticsStream))
+	{
+		ShutDown(pWindow);
+		return EXIT_CODE_STARTUP_FAILED;
+	}
 
 	//Initialize "framework"
 	/*const*/ auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
-
-	//const auto pScene = new Scene_W1();
-	//const auto pScene = new Scene_W2();
-	//const auto pScene = new Scene_W3();
-	//const auto pScene = new Scene_W3_TestScene();
-	//const auto pScene = new Scene_W4_TestScene();
-	//const auto pScene = new Scene_W4_ReferenceScene();
-	const auto pScene = new Scene_W4_BunnyScene();
+	const auto pFrameBuffer = new FrameBuffer(pWindow);
+	const auto pRenderer = new Renderer(pFrameBuffer);
+	ConfigureRenderer(pRenderer, options);
 
 	pScene->Initialize();
 
@@ -78,14 +451,29 @@ int main(int argc, char* args[])
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderer->TogglePacketTracing();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					ToggleTraceCapture();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
-					pTimer->StartBenchmark();
+					pRenderer->ToggleProgressive();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					std::cout << Statistics::ToText(pRenderer->GetSampleDistribution());
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->CycleCostMetric();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->ToggleDynamicResolution();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					pRenderer->ToggleReprojection();
 				break;
 			}
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		{
+			TRACE_ZONE("Scene::Update");
+			pScene->Update(pTimer);
+		}
 
 		//--------- Render ---------
 		pRenderer->Render(pScene);
@@ -95,8 +483,14 @@ int main(int argc, char* args[])
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
+			const RenderStatistics& statistics{ pRenderer->GetAccumulatedStatistics() };
+			std::cout << "dFPS: " << pTimer->GetdFPS() << ", " << pRenderer->GetRenderWidth() << "x" << pRenderer->GetRenderHeight() << ", "
+				<< Statistics::ToText(statistics, printTimer) << std::endl;
+			if (statisticsStream.is_open())
+				statisticsStream << Statistics::ToJSON(statistics, printTimer) << std::endl;
+
+			pRenderer->ResetAccumulatedStatistics();
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
 		}
 
 		//Save screenshot after full render
@@ -106,16 +500,61 @@ int main(int argc, char* args[])
 				std::cout << "Screenshot saved!" << std::endl;
 			else
 				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+
+			//The raw costs go next to the heatmap
+			if (pRenderer->GetLightingMode() == Renderer::LightingMode::Cost && !pRenderer->SaveCostImage("RayTracing_Cost.pfm"))
+				std::cout << "Something went wrong. Cost image not saved!" << std::endl;
 			takeScreenshot = false;
 		}
 	}
 	pTimer->Stop();
 
 	//Shutdown "framework"
-	delete pScene;
 	delete pRenderer;
+	delete pFrameBuffer;
 	delete pTimer;
 
 	ShutDown(pWindow);
-	return 0;
-}
\ No newline at end of file
+	return EXIT_CODE_SUCCESS;
+}
+
+int main(int argc, char* args[])
+{
+	Trace::SetThreadName("Main");
+
+	LaunchOptions options{};
+	if (!ParseArguments(argc, args, options))
+	{
+		PrintUsage();
+		return EXIT_CODE_STARTUP_FAILED;
+	}
+
+	if (options.showHelp)
+	{
+		PrintUsage();
+		return EXIT_CODE_SUCCESS;
+	}
+
+	if (options.isBenchmark)
+		return RunBenchmark(options);
+
+	if (options.sceneName.empty())
+		options.sceneName = "Scene_W4_BunnyScene";
+
+	Scene* pScene{ CreateScene(options.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene " << options.sceneName << ", expected one of:";
+		for (const std::string& name : GetSceneNames())
+		{
+			std::cout << " " << name;
+		}
+		std::cout << "\n";
+		return EXIT_CODE_STARTUP_FAILED;
+	}
+
+	const int exitCode{ options.isHeadless ? RunHeadless(options, pScene) : RunWindowed(options, pScene) };
+
+	delete pScene;
+	return exitCode;
+}